@@ -6,6 +6,7 @@ found in the LICENSE file.
 #include <pthread.h>
 #include "backend_dump.h"
 #include "util/log.h"
+#include "util/thread.h"
 
 BackendDump::BackendDump(SSDB *ssdb){
 	this->ssdb = ssdb;
@@ -31,6 +32,7 @@ void BackendDump::proc(const Link *link){
 
 void* BackendDump::_run_thread(void *arg){
 	pthread_detach(pthread_self());
+	unpin_thread();
 	struct run_arg *p = (struct run_arg*)arg;
 	const BackendDump *backend = p->backend;
 	Link *link = (Link *)p->link;
@@ -7,14 +7,20 @@ found in the LICENSE file.
 #include <assert.h>
 #include <errno.h>
 #include <string>
+#include <unordered_map>
+#include <algorithm>
 #include "backend_sync.h"
 #include "util/log.h"
 #include "util/string_util.h"
+#include "util/file.h"
 
-BackendSync::BackendSync(SSDBImpl *ssdb, int sync_speed){
+BackendSync::BackendSync(SSDBImpl *ssdb, int sync_speed, int sync_window, int copy_speed, int total_speed){
 	thread_quit = false;
 	this->ssdb = ssdb;
 	this->sync_speed = sync_speed;
+	this->copy_speed = copy_speed;
+	this->total_limiter.set_rate(total_speed * 1024.0 * 1024.0);
+	this->sync_window = sync_window > 0? sync_window : 0;
 }
 
 BackendSync::~BackendSync(){
@@ -49,6 +55,77 @@ std::vector<std::string> BackendSync::stats(){
 	return ret;
 }
 
+int BackendSync::set_speed(const std::string &type, double speed){
+	Locking l(&mutex);
+	if(type == "sync"){
+		sync_speed = speed;
+	}else if(type == "copy"){
+		copy_speed = speed;
+	}else if(type == "total"){
+		total_limiter.set_rate(speed * 1024 * 1024);
+	}else{
+		return -1;
+	}
+	log_info("%s speed: %.2f MB/s", type.c_str(), speed);
+	return 0;
+}
+
+void BackendSync::set_weight(const std::string &ip, int weight){
+	Locking l(&mutex);
+	if(weight <= 0 || weight == 1){
+		weights.erase(ip);
+		weight = 1;
+	}else{
+		weights[ip] = weight;
+	}
+	for(auto c : workers){
+		if(ip == c->link->remote_ip){
+			c->weight = weight;
+		}
+	}
+	log_info("%s weight: %d", ip.c_str(), weight);
+}
+
+std::vector<std::string> BackendSync::speeds(){
+	std::vector<std::string> ret;
+	Locking l(&mutex);
+	ret.push_back("sync");
+	ret.push_back(str(sync_speed));
+	ret.push_back("copy");
+	ret.push_back(str(copy_speed));
+	ret.push_back("total");
+	ret.push_back(str(total_limiter.rate() / 1024 / 1024));
+	for(auto &it : weights){
+		ret.push_back("weight." + it.first);
+		ret.push_back(str(it.second));
+	}
+	return ret;
+}
+
+int64_t BackendSync::throttle(Client *client, int64_t bytes, bool is_copy){
+	if(bytes <= 0){
+		return 0;
+	}
+	double speed;
+	int total_weight = 0;
+	{
+		Locking l(&mutex);
+		speed = is_copy? copy_speed : sync_speed;
+		for(auto c : workers){
+			if(is_copy? c->status == Client::COPY : !c->is_range && !c->is_checkpoint){
+				total_weight += c->weight;
+			}
+		}
+	}
+	RateLimiter *limiter = is_copy? &client->copy_limiter : &client->sync_limiter;
+	if(speed > 0 && total_weight > 0){
+		limiter->set_rate(speed * 1024 * 1024 * client->weight / total_weight);
+	}else{
+		limiter->set_rate(0);
+	}
+	return std::max(limiter->take(bytes), total_limiter.take(bytes));
+}
+
 void BackendSync::proc(const Link *link){
 	log_info("fd: %d, accept sync client", link->fd());
 	struct run_arg *arg = new run_arg();
@@ -65,6 +142,7 @@ void BackendSync::proc(const Link *link){
 
 void* BackendSync::_run_thread(void *arg){
 	pthread_detach(pthread_self());
+	unpin_thread();
 	struct run_arg *p = (struct run_arg*)arg;
 	BackendSync *backend = (BackendSync *)p->backend;
 	Link *link = (Link *)p->link;
@@ -82,56 +160,90 @@ void* BackendSync::_run_thread(void *arg){
 
 	{
 		Locking l(&backend->mutex);
+		auto it = backend->weights.find(link->remote_ip);
+		if(it != backend->weights.end()){
+			client.weight = it->second;
+		}
 		backend->workers.insert(&client);
 	}
 
-// sleep longer to reduce logs.find
+// wait at most this long for new logs, commits wake us up earlier
 #define TICK_INTERVAL_MS	300
 #define NOOP_IDLES			(3000/TICK_INTERVAL_MS)
 
 	int idle = 0;
+	// copy waits for its budget without holding back binlogs
+	int64_t copy_resume = 0;
 	while(!backend->thread_quit){
 		// TODO: test
 		//usleep(2000 * 1000);
 		
 		bool is_empty = true;
+		bool can_copy = time_ms() >= copy_resume;
 		if(client.status == Client::OUT_OF_SYNC){
 			// will sleep afterwards.
 			// ssdb doesn't do anything, let people interfere, normally, people
 			// should make a backup of slave, stop, delete the meta and data
 			// folders, and startup again.
+		}else if(client.is_range){
+			// binlogs go over the sync link of the slave
+			if(client.status == Client::COPY && can_copy){
+				if(client.copy()){
+					is_empty = false;
+				}
+			}
 		}else{
 			// WARN: MUST do first sync() before first copy(), because
 			// sync() will refresh last_seq, and copy() will not
 			if(client.sync(logs)){ // sync seq or binlog
 				is_empty = false;
 			}
-			if(client.status == Client::COPY){
+			if(client.status == Client::COPY && can_copy){
 				if(client.copy()){
 					is_empty = false;
 				}
 			}
 		}
 		if(is_empty){
-			if(idle >= NOOP_IDLES){
+			if(idle >= NOOP_IDLES && client.status != Client::OUT_OF_SYNC){
 				idle = 0;
 				client.noop();
 			}else{
-				idle ++;
-				usleep(TICK_INTERVAL_MS * 1000);
+				int wait_ms = TICK_INTERVAL_MS;
+				if(client.status == Client::COPY && !can_copy){
+					wait_ms = std::min((int64_t)wait_ms, std::max((int64_t)1, copy_resume - time_ms()));
+				}else{
+					idle ++;
+				}
+				if(client.status == Client::OUT_OF_SYNC || client.is_range){
+					usleep(wait_ms * 1000);
+				}else{
+					logs->wait_for(client.last_seq + 1, wait_ms);
+				}
 			}
 		}else{
 			idle = 0;
 		}
 
+		client.flush_frame();
 		if(link->flush() == -1){
 			log_info("%s:%d fd: %d, send error: %s", link->remote_ip, link->remote_port, link->fd(), strerror(errno));
 			break;
 		}
-		if(backend->sync_speed > 0){
-			float data_size_mb = link->output->size() / 1024.0 / 1024.0;
-			usleep((data_size_mb / backend->sync_speed) * 1000 * 1000);
+		if(client.is_range && client.status != Client::COPY){
+			log_info("%s:%d fd: %d, range copied", link->remote_ip, link->remote_port, link->fd());
+			break;
 		}
+		int64_t wait = backend->throttle(&client, client.copy_bytes, true);
+		if(wait > 0){
+			copy_resume = time_ms() + wait / 1000;
+		}
+		wait = backend->throttle(&client, client.sync_bytes, false);
+		if(wait > 0){
+			usleep(wait);
+		}
+		client.copy_bytes = 0;
+		client.sync_bytes = 0;
 	}
 
 	log_info("Sync Client quit, %s:%d fd: %d, delete link", link->remote_ip, link->remote_port, link->fd());
@@ -142,6 +254,111 @@ void* BackendSync::_run_thread(void *arg){
 	return (void *)NULL;
 }
 
+void BackendSync::checkpoint(const Link *link){
+	log_info("fd: %d, accept checkpoint client", link->fd());
+	struct run_arg *arg = new run_arg();
+	arg->link = link;
+	arg->backend = this;
+
+	pthread_t tid;
+	int err = pthread_create(&tid, NULL, &BackendSync::_checkpoint_thread, arg);
+	if(err != 0){
+		log_error("can't create thread: %s", strerror(err));
+		delete link;
+	}
+}
+
+// sends ["file", name, offset, data] chunks of every file in a new
+// checkpoint, then ["end", seq]
+void* BackendSync::_checkpoint_thread(void *arg){
+	pthread_detach(pthread_self());
+	unpin_thread();
+	struct run_arg *p = (struct run_arg*)arg;
+	BackendSync *backend = (BackendSync *)p->backend;
+	Link *link = (Link *)p->link;
+	delete p;
+
+	link->noblock(false);
+
+	std::string dir;
+	uint64_t seq;
+	std::vector<std::string> names;
+	if(backend->ssdb->checkpoint(&dir, &seq) == -1 || scan_dir(dir, &names) == -1){
+		link->send("error", "checkpoint failed");
+		link->flush();
+		link->read();
+		delete link;
+		return (void *)NULL;
+	}
+	log_info("fd: %d, checkpoint %s, %d files, seq: %" PRIu64 "", link->fd(), dir.c_str(), (int)names.size(), seq);
+
+	// a copy client, sharing copy_speed with the others by weight
+	Client client(backend);
+	client.link = link;
+	client.status = Client::COPY;
+	client.is_checkpoint = true;
+	client.last_seq = seq;
+	{
+		Locking l(&backend->mutex);
+		auto it = backend->weights.find(link->remote_ip);
+		if(it != backend->weights.end()){
+			client.weight = it->second;
+		}
+		backend->workers.insert(&client);
+	}
+	bool ok = true;
+	std::string buf(1024 * 1024, '\0');
+	for(int i = 0; i < (int)names.size() && ok && !backend->thread_quit; i++){
+		FILE *fp = fopen((dir + "/" + names[i]).c_str(), "rb");
+		if(!fp){
+			log_error("fd: %d, open %s error: %s", link->fd(), names[i].c_str(), strerror(errno));
+			ok = false;
+			break;
+		}
+		uint64_t offset = 0;
+		bool first = true;
+		while(true){
+			int n = fread(&buf[0], 1, buf.size(), fp);
+			// an empty file is sent as one empty chunk, so the slave has it too
+			if(n == 0 && (!first || ferror(fp))){
+				break;
+			}
+			first = false;
+			link->send("file", names[i], str(offset), Bytes(buf.data(), n));
+			offset += n;
+			int len = link->output->size();
+			if(link->flush() == -1){
+				log_info("fd: %d, send error: %s", link->fd(), strerror(errno));
+				ok = false;
+				break;
+			}
+			int64_t wait = backend->throttle(&client, len, true);
+			if(wait > 0){
+				usleep(wait);
+			}
+		}
+		if(ferror(fp)){
+			ok = false;
+		}
+		fclose(fp);
+	}
+	if(ok && !backend->thread_quit){
+		link->send("end", str(seq));
+		if(link->flush() != -1){
+			// wait for the slave to close the connection
+			link->read();
+		}
+	}
+	{
+		Locking l(&backend->mutex);
+		backend->workers.erase(&client);
+	}
+	log_info("fd: %d, checkpoint %s, delete link", link->fd(), ok? "sent" : "failed");
+	delete link;
+	remove_dir(dir);
+	return (void *)NULL;
+}
+
 
 /* Client */
 
@@ -154,6 +371,13 @@ BackendSync::Client::Client(const BackendSync *backend){
 	last_key = "";
 	is_mirror = false;
 	iter = NULL;
+	wal_reader = NULL;
+	coalesced = 0;
+	is_range = false;
+	is_checkpoint = false;
+	sync_bytes = 0;
+	copy_bytes = 0;
+	weight = 1;
 }
 
 BackendSync::Client::~Client(){
@@ -161,18 +385,28 @@ BackendSync::Client::~Client(){
 		delete iter;
 		iter = NULL;
 	}
+	if(wal_reader){
+		delete wal_reader;
+		wal_reader = NULL;
+	}
 }
 
 std::string BackendSync::Client::stats(){
 	std::string s;
 	s.append("client " + str(link->remote_ip) + ":" + str(link->remote_port) + "\n");
 	s.append("    type     : ");
-	if(is_mirror){
+	if(is_checkpoint){
+		s.append("checkpoint\n");
+	}else if(is_mirror){
 		s.append("mirror\n");
 	}else{
 		s.append("sync\n");
 	}
 	
+	if(is_range){
+		s.append("    range    : '" + hexmem(last_key.data(), last_key.size()) + "', '"
+			+ hexmem(range_end.data(), range_end.size()) + "'\n");
+	}
 	s.append("    status   : ");
 	switch(status){
 	case INIT:
@@ -189,12 +423,25 @@ std::string BackendSync::Client::stats(){
 		break;
 	}
 	
+	if(!frame_codec.empty()){
+		s.append("    frame    : " + frame_codec + "\n");
+	}
+	if(weight != 1){
+		s.append("    weight   : " + str(weight) + "\n");
+	}
 	s.append("    last_seq : " + str(last_seq) + "");
+	if(backend->sync_window > 1){
+		s.append("\n    coalesced: " + str(coalesced) + "");
+	}
 	return s;
 }
 
 void BackendSync::Client::init(){
 	const std::vector<Bytes> *req = this->link->last_recv();
+	if((*req)[0] == "copy_range"){
+		this->init_range(*req);
+		return;
+	}
 	last_seq = 0;
 	if(req->size() > 1){
 		last_seq = (*req)[1].Uint64();
@@ -209,6 +456,14 @@ void BackendSync::Client::init(){
 			is_mirror = true;
 		}
 	}
+	// frames the slave can decode, older slaves don't send it
+	if(req->size() > 4){
+		std::string codec = (*req)[4].String();
+		if(codec == "lz4" || codec == "raw"){
+			frame_codec = codec;
+			log_info("%s:%d fd: %d, frame: %s", link->remote_ip, link->remote_port, link->fd(), codec.c_str());
+		}
+	}
 	
 	SSDBImpl *ssdb = (SSDBImpl *)backend->ssdb;
 	BinlogQueue *logs = ssdb->binlogs;
@@ -237,7 +492,7 @@ void BackendSync::Client::init(){
 		
 		Binlog log(this->last_seq, BinlogType::COPY, BinlogCommand::END, "");
 		log_trace("fd: %d, %s", link->fd(), log.dumps().c_str());
-		link->send(log.repr(), "copy_end");
+		this->send(log.repr(), "copy_end");
 	}else if(last_key == "" && last_seq == 0){
 		log_info("[%s] %s:%d fd: %d, copy begin, seq: %" PRIu64 ", key: '%s'",
 			type,
@@ -257,6 +512,24 @@ void BackendSync::Client::init(){
 	}
 }
 
+void BackendSync::Client::init_range(const std::vector<Bytes> &req){
+	is_range = true;
+	status = Client::COPY;
+	if(req.size() > 1){
+		last_key = req[1].String();
+	}
+	if(req.size() > 2){
+		range_end = req[2].String();
+	}
+	if(req.size() > 3 && (req[3] == "lz4" || req[3] == "raw")){
+		frame_codec = req[3].String();
+	}
+	log_info("%s:%d fd: %d, copy range ('%s', '%s']",
+		link->remote_ip, link->remote_port, link->fd(),
+		hexmem(last_key.data(), last_key.size()).c_str(),
+		hexmem(range_end.data(), range_end.size()).c_str());
+}
+
 void BackendSync::Client::reset(){
 	log_info("%s:%d fd: %d, copy begin", link->remote_ip, link->remote_port, link->fd());
 	this->status = Client::COPY;
@@ -265,13 +538,62 @@ void BackendSync::Client::reset(){
 
 	Binlog log(this->last_seq, BinlogType::COPY, BinlogCommand::BEGIN, "");
 	log_trace("fd: %d, %s", link->fd(), log.dumps().c_str());
-	link->send(log.repr(), "copy_begin");
+	this->send(log.repr(), "copy_begin");
+}
+
+void BackendSync::Client::count(const std::string &log, int64_t size){
+	if(log.size() > sizeof(uint64_t) && log[sizeof(uint64_t)] == BinlogType::COPY){
+		copy_bytes += size;
+	}else{
+		sync_bytes += size;
+	}
+}
+
+void BackendSync::Client::send(const std::string &log){
+	this->count(log, log.size());
+	if(frame_codec.empty()){
+		link->send(log);
+		return;
+	}
+	frame.add(log);
+	if(frame.size() >= FRAME_SIZE){
+		this->flush_frame();
+	}
+}
+
+void BackendSync::Client::send(const std::string &log, const Bytes &val){
+	this->count(log, log.size() + val.size());
+	if(frame_codec.empty()){
+		link->send(log, val);
+		return;
+	}
+	frame.add(log, val);
+	if(frame.size() >= FRAME_SIZE){
+		this->flush_frame();
+	}
+}
+
+void BackendSync::Client::flush_frame(){
+	if(frame.count() == 0){
+		return;
+	}
+	std::string data;
+	std::string codec = frame_codec;
+	if(frame.encode(codec, &data) == -1){
+		log_error("fd: %d, encode %s frame error, send raw", link->fd(), codec.c_str());
+		codec = "raw";
+		frame.encode(codec, &data);
+	}
+	Binlog log(this->last_seq, BinlogType::CTRL, BinlogCommand::FRAME, codec);
+	log_trace("fd: %d, %s, %d logs, %d bytes", link->fd(), log.dumps().c_str(), frame.count(), (int)data.size());
+	link->send(log.repr(), data);
+	frame.clear();
 }
 
 void BackendSync::Client::out_of_sync(){
 	this->status = Client::OUT_OF_SYNC;
 	Binlog noop(this->last_seq, BinlogType::CTRL, BinlogCommand::NONE, "OUT_OF_SYNC");
-	link->send(noop.repr());
+	this->send(noop.repr());
 }
 
 void BackendSync::Client::noop(){
@@ -284,7 +606,7 @@ void BackendSync::Client::noop(){
 	}
 	Binlog noop(seq, BinlogType::NOOP, BinlogCommand::NONE, "");
 	//log_debug("fd: %d, %s", link->fd(), noop.dumps().c_str());
-	link->send(noop.repr(), "noop");
+	this->send(noop.repr(), "noop");
 }
 
 int BackendSync::Client::copy(){
@@ -294,7 +616,13 @@ int BackendSync::Client::copy(){
 		if(this->last_key.empty()){
 			key.push_back(DataType::MIN_PREFIX);
 		}
-		this->iter = backend->ssdb->iterator(key, "", -1);
+		if(this->is_range){
+			// the slave replays binlogs after the smallest seq of its ranges
+			this->last_seq = backend->ssdb->binlogs->committed_seq();
+			Binlog log(this->last_seq, BinlogType::COPY, BinlogCommand::BEGIN, "");
+			this->send(log.repr(), "copy_begin");
+		}
+		this->iter = backend->ssdb->iterator(key, this->range_end, -1);
 		log_info("iterator created, last_key: '%s'", hexmem(last_key.data(), last_key.size()).c_str());
 	}
 	int ret = 0;
@@ -302,7 +630,7 @@ int BackendSync::Client::copy(){
 	int64_t stime = time_ms();
 	while(true){
 		// Prevent copy() from blocking too long
-		if(++iterate_count > 1000 || link->output->size() > 2 * 1024 * 1024){
+		if(++iterate_count > 1000 || link->output->size() + frame.size() > 2 * 1024 * 1024){
 			break;
 		}
 		
@@ -337,7 +665,7 @@ int BackendSync::Client::copy(){
 		
 		Binlog log(this->last_seq, BinlogType::COPY, cmd, slice(key));
 		log_trace("fd: %d, %s", link->fd(), log.dumps().c_str());
-		link->send(log.repr(), val);
+		this->send(log.repr(), val);
 		
 		if(time_ms() - stime > 3000){
 			log_info("copy blocks too long, flush");
@@ -354,30 +682,126 @@ copy_end:
 
 	Binlog log(this->last_seq, BinlogType::COPY, BinlogCommand::END, "");
 	log_trace("fd: %d, %s", link->fd(), log.dumps().c_str());
-	link->send(log.repr(), "copy_end");
+	this->send(log.repr(), "copy_end");
 	return 1;
 }
 
 // sync seq and/or binlog
 int BackendSync::Client::sync(BinlogQueue *logs){
+	if(logs->is_wal() && this->status == Client::COPY && this->last_seq == 0){
+		// the copy iterator, created after this, has every earlier write
+		this->last_seq = logs->max_seq();
+		return 0;
+	}
+	if(backend->sync_window > 1){
+		return this->sync_window(logs);
+	}
 	Binlog log;
+	int ret = this->next_log(logs, &log);
+	if(ret == 0){
+		return 0;
+	}
+	if(ret == 1){
+		this->send_log(log);
+	}else{
+		this->send_ctrl(ret);
+	}
+	return 1;
+}
+
+// Reads up to sync_window binlogs and sends only the last one of each key,
+// in seq order. Logs of KSET/HSET/ZSET carry the value read when sending,
+// so the last one stands for all. A key with more than one log ending in
+// HMERGE is sent as HSET, since its operand alone misses the earlier ones.
+// Queue logs depend on order and are all sent.
+int BackendSync::Client::sync_window(BinlogQueue *logs){
+	std::vector<Binlog> window;
+	// key => [index of its last log, number of logs]
+	std::unordered_map<std::string, std::pair<int, int>> last;
+	int ret = 0;
+	while(window.size() < backend->sync_window){
+		Binlog log;
+		ret = this->next_log(logs, &log);
+		if(ret != 1){
+			break;
+		}
+		if(!is_queue_log(log.cmd())){
+			std::pair<int, int> &item = last[log.key().String()];
+			item.first = (int)window.size();
+			item.second ++;
+		}
+		window.push_back(log);
+	}
+	for(int i = 0; i < (int)window.size(); i++){
+		const Binlog &log = window[i];
+		if(is_queue_log(log.cmd())){
+			this->send_log(log);
+			continue;
+		}
+		const std::pair<int, int> &item = last[log.key().String()];
+		if(item.first != i){
+			this->coalesced ++;
+			continue;
+		}
+		if(log.cmd() == BinlogCommand::HMERGE && item.second > 1){
+			this->send_log(Binlog(log.seq(), log.type(), BinlogCommand::HSET, slice(log.key())));
+		}else{
+			this->send_log(log);
+		}
+	}
+	// after the logs read before it
+	if(ret == 2 || ret == -1){
+		this->send_ctrl(ret);
+	}
+	if(window.empty() && ret == 0){
+		return 0;
+	}
+	return 1;
+}
+
+// sends what next_log() returned instead of a log
+void BackendSync::Client::send_ctrl(int ret){
+	if(ret == -1){
+		this->out_of_sync();
+	}else if(ret == 2){
+		this->noop();
+	}
+}
+
+/** @returns
+ 2 : a noop is due instead of a log
+ 1 : log is the next one to send
+ 0 : no more logs
+ -1: out of sync, nothing may be sent after it
+ */
+int BackendSync::Client::next_log(BinlogQueue *logs, Binlog *log){
 	while(1){
 		int ret = 0;
 		uint64_t expect_seq = this->last_seq + 1;
-		if(this->status == Client::COPY && this->last_seq == 0){
-			ret = logs->find_last(&log);
+		if(logs->is_wal()){
+			if(!this->wal_reader){
+				this->wal_reader = new WalLogReader(logs);
+			}
+			ret = this->wal_reader->find_next(expect_seq, log);
+			if(ret == -1){
+				log_error("%s:%d fd: %d OUT_OF_SYNC! seq: %" PRIu64 " not in wal",
+					link->remote_ip, link->remote_port, link->fd(), expect_seq);
+				return -1;
+			}
+		}else if(this->status == Client::COPY && this->last_seq == 0){
+			ret = logs->find_last(log);
 		}else{
-			ret = logs->find_next(expect_seq, &log);
+			ret = logs->find_next(expect_seq, log);
 		}
 		if(ret == 0){
 			return 0;
 		}
-		if(this->status == Client::COPY && log.key() > this->last_key){
+		if(this->status == Client::COPY && log->key() > this->last_key){
 			log_debug("fd: %d, last_key: '%s', drop: %s",
 				link->fd(),
 				hexmem(this->last_key.data(), this->last_key.size()).c_str(),
-				log.dumps().c_str());
-			this->last_seq = log.seq();
+				log->dumps().c_str());
+			this->last_seq = log->seq();
 			// WARN: When there are writes behind last_key, we MUST create
 			// a new iterator, because iterator will not know this key.
 			// Because iterator ONLY iterates throught keys written before
@@ -389,20 +813,21 @@ int BackendSync::Client::sync(BinlogQueue *logs){
 			continue;
 		}
 		// update last_seq
-		this->last_seq = log.seq();
+		this->last_seq = log->seq();
 
-		char type = log.type();
+		char type = log->type();
 		if(type == BinlogType::MIRROR && this->is_mirror){
 			if(this->last_seq - this->last_noop_seq >= 1000){
-				this->noop();
-				return 1;
+				return 2;
 			}else{
 				continue;
 			}
 		}
-		break;
+		return 1;
 	}
+}
 
+void BackendSync::Client::send_log(const Binlog &log){
 	int ret = 0;
 	TERARKDB_NAMESPACE::LazyBuffer val;
 	switch(log.cmd()){
@@ -417,7 +842,7 @@ int BackendSync::Client::sync(BinlogQueue *logs){
 				log_trace("fd: %d, skip not found: %s", link->fd(), log.dumps().c_str());
 			}else{
 				log_trace("fd: %d, %s", link->fd(), log.dumps().c_str());
-				link->send(log.repr(), Bytes(val.data(), val.size()));
+				this->send(log.repr(), Bytes(val.data(), val.size()));
 			}
 			break;
 		case BinlogCommand::QSET:
@@ -429,17 +854,17 @@ int BackendSync::Client::sync(BinlogQueue *logs){
 			}else{
 				// ret == 0: element popped, push an empty value(pop later in binlog)
 				log_trace("fd: %d, %s", link->fd(), log.dumps().c_str());
-				link->send(log.repr(), Bytes(val.data(), val.size()));
+				this->send(log.repr(), Bytes(val.data(), val.size()));
 			}
 			break;
 		case BinlogCommand::KDEL:
 		case BinlogCommand::HDEL:
+		case BinlogCommand::HMERGE:
 		case BinlogCommand::ZDEL:
 		case BinlogCommand::QPOP_BACK:
 		case BinlogCommand::QPOP_FRONT:
 			log_trace("fd: %d, %s", link->fd(), log.dumps().c_str());
-			link->send(log.repr());
+			this->send(log.repr());
 			break;
 	}
-	return 1;
 }
@@ -10,11 +10,13 @@ found in the LICENSE file.
 #include <vector>
 #include <string>
 #include <set>
+#include <map>
 
 #include "ssdb/ssdb_impl.h"
 #include "ssdb/binlog.h"
 #include "net/link.h"
 #include "util/thread.h"
+#include "util/rate_limiter.h"
 
 class BackendSync{
 private:
@@ -29,16 +31,34 @@ private:
 	};
 	volatile bool thread_quit;
 	static void* _run_thread(void *arg);
+	static void* _checkpoint_thread(void *arg);
 	Mutex mutex;
 	std::set<Client *> workers;
 	SSDBImpl *ssdb;
-	int sync_speed;
+	// in MB/s, <= 0: no limit. Binlogs and copies have their own budgets,
+	// each split among clients by weight, and all of it is capped by total
+	double sync_speed;
+	double copy_speed;
+	RateLimiter total_limiter;
+	// by slave ip, 1 if not set
+	std::map<std::string, int> weights;
+	// max binlogs read at once to send each key only once, 0 disables
+	size_t sync_window;
+	// takes bytes sent by client, returns microseconds to wait
+	int64_t throttle(Client *client, int64_t bytes, bool is_copy);
 public:
-	BackendSync(SSDBImpl *ssdb, int sync_speed);
+	BackendSync(SSDBImpl *ssdb, int sync_speed, int sync_window=0, int copy_speed=-1, int total_speed=-1);
 	~BackendSync();
 	void proc(const Link *link);
+	// streams a checkpoint of the db to a bootstrapping slave
+	void checkpoint(const Link *link);
 	
 	std::vector<std::string> stats();
+	// type: sync|copy|total, returns -1 on unknown type
+	int set_speed(const std::string &type, double speed);
+	void set_weight(const std::string &ip, int weight);
+	// name, value pairs of speeds and weights
+	std::vector<std::string> speeds();
 };
 
 struct BackendSync::Client{
@@ -56,16 +76,48 @@ struct BackendSync::Client{
 	bool is_mirror;
 	
 	Iterator *iter;
+	// binlogs in wal mode
+	WalLogReader *wal_reader;
+	// logs skipped by sync_window
+	uint64_t coalesced;
+	// logs are sent in frames when the slave asked for a codec
+	static const size_t FRAME_SIZE = 4 * 1024 * 1024;
+	std::string frame_codec;
+	BinlogFrame frame;
+	// copy_range stream, copies (last_key, range_end] and quits
+	bool is_range;
+	std::string range_end;
+	// streams a checkpoint, only counted against copy_speed
+	bool is_checkpoint;
+	// bytes sent since the last throttle, by log type
+	int64_t sync_bytes;
+	int64_t copy_bytes;
+	int weight;
+	RateLimiter sync_limiter;
+	RateLimiter copy_limiter;
 
 	Client(const BackendSync *backend);
 	~Client();
 	void init();
+	void init_range(const std::vector<Bytes> &req);
 	void reset();
 	void noop();
 	int copy();
 	int sync(BinlogQueue *logs);
+	int sync_window(BinlogQueue *logs);
+	int next_log(BinlogQueue *logs, Binlog *log);
+	void send_ctrl(int ret);
+	void send_log(const Binlog &log);
+	void send(const std::string &log);
+	void send(const std::string &log, const Bytes &val);
+	void flush_frame();
+	void count(const std::string &log, int64_t size);
 	void out_of_sync();
 
+	static bool is_queue_log(char cmd){
+		return cmd >= BinlogCommand::QPUSH_BACK && cmd <= BinlogCommand::QSET;
+	}
+
 	std::string stats();
 };
 
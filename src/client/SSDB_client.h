@@ -155,6 +155,14 @@ public:
 	 * The two elements at ret[n] and ret[n+1] form a key-value pair, n=0,2,4,...
 	 */
 	virtual Status hgetall(const std::string &name, std::vector<std::string> *ret) = 0;
+	/**
+	 * Return the best moves of a position, ordered by score.
+	 * The two elements at ret[n] and ret[n+1] form a key-value pair, n=0,2,4,...
+	 * @param limit At most this many moves, 0 means no limit.
+	 * @param margin Only moves within margin of the best one, -1 means no limit.
+	 */
+	virtual Status hbest(const std::string &name, int limit, int margin,
+		std::vector<std::string> *ret) = 0;
 	/**
 	 * Return key-value pairs.
 	 * The two elements at ret[n] and ret[n+1] form a key-value pair, n=0,2,4,...
@@ -175,8 +183,30 @@ public:
 	 */
 	virtual Status multi_hget(const std::string &name, const std::vector<std::string> &keys,
 		std::vector<std::string> *ret) = 0;
+	/**
+	 * Return all pairs of many hashmaps in one request, skipping missing ones.
+	 * Each hashmap found is returned as name, size, then size key-value pairs.
+	 */
+	virtual Status multi_hgetall(const std::vector<std::string> &names,
+		std::vector<std::string> *ret) = 0;
 	virtual Status multi_hset(const std::string &name, const std::unordered_map<std::string, std::string> &kvs) = 0;
 	virtual Status multi_hdel(const std::string &name, const std::vector<std::string> &keys) = 0;
+	/**
+	 * The *_packed methods switch the connection into binary mode and
+	 * return raw 4-byte entries (int16 move, int16 score, native byte
+	 * order) instead of decimal strings. The other hash reads switch it back.
+	 */
+	virtual Status hgetall_packed(const std::string &name, std::string *packed) = 0;
+	/**
+	 * Return name, packed entries pairs of the hashmaps found.
+	 */
+	virtual Status multi_hgetall_packed(const std::vector<std::string> &names,
+		std::vector<std::string> *ret) = 0;
+	virtual Status multi_hget_packed(const std::string &name, const std::vector<std::string> &keys,
+		std::string *packed) = 0;
+	virtual Status hscan_packed(const std::string &name,
+		const std::string &key_start, const std::string &key_end,
+		uint64_t limit, std::string *packed) = 0;
 	/// @}
 
 
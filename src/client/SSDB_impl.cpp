@@ -46,6 +46,7 @@ Status _read_str(const std::vector<std::string> *resp, std::string *ret){
 
 ClientImpl::ClientImpl(){
 	link = NULL;
+	binary_ = false;
 }
 
 ClientImpl::~ClientImpl(){
@@ -271,7 +272,24 @@ Status ClientImpl::migrate_hset(const std::vector<std::string> &items) {
 	return s;
 }
 
+Status ClientImpl::binary(bool on){
+	if(binary_ == on){
+		return Status("ok");
+	}
+	const std::vector<std::string> *resp;
+	resp = this->request("binary", on? "on" : "off");
+	Status s(resp);
+	if(s.ok()){
+		binary_ = on;
+	}
+	return s;
+}
+
 Status ClientImpl::hget(const std::string &name, const std::string &key, std::string *val){
+	Status s = binary(false);
+	if(!s.ok()){
+		return s;
+	}
 	const std::vector<std::string> *resp;
 	resp = this->request("hget", name, key);
 	return _read_str(resp, val);
@@ -323,15 +341,31 @@ Status ClientImpl::hkeys(const std::string &name,
 Status ClientImpl::hgetall(const std::string &name,
 	 std::vector<std::string> *ret)
 {
+	Status s = binary(false);
+	if(!s.ok()){
+		return s;
+	}
 	const std::vector<std::string> *resp;
 	resp = this->request("hgetall", name );
 	return _read_list(resp, ret);
 }
 
+Status ClientImpl::hbest(const std::string &name, int limit, int margin,
+	std::vector<std::string> *ret)
+{
+	const std::vector<std::string> *resp;
+	resp = this->request("hbest", name, str(limit), str(margin));
+	return _read_list(resp, ret);
+}
+
 Status ClientImpl::hscan(const std::string &name,
 	const std::string &key_start, const std::string &key_end,
 	uint64_t limit, std::vector<std::string> *ret)
 {
+	Status s = binary(false);
+	if(!s.ok()){
+		return s;
+	}
 	std::string s_limit = str(limit);
 	const std::vector<std::string> *resp;
 	resp = this->request("hscan", name, key_start, key_end, s_limit);
@@ -342,6 +376,10 @@ Status ClientImpl::hrscan(const std::string &name,
 	const std::string &key_start, const std::string &key_end,
 	uint64_t limit, std::vector<std::string> *ret)
 {
+	Status s = binary(false);
+	if(!s.ok()){
+		return s;
+	}
 	std::string s_limit = str(limit);
 	const std::vector<std::string> *resp;
 	resp = this->request("hrscan", name, key_start, key_end, s_limit);
@@ -350,11 +388,26 @@ Status ClientImpl::hrscan(const std::string &name,
 
 Status ClientImpl::multi_hget(const std::string &name, const std::vector<std::string> &keys,
 	std::vector<std::string> *ret){
+	Status s = binary(false);
+	if(!s.ok()){
+		return s;
+	}
 	const std::vector<std::string> *resp;
 	resp = this->request("multi_hget", name, keys);
 	return _read_list(resp, ret);
 }
 
+Status ClientImpl::multi_hgetall(const std::vector<std::string> &names,
+	std::vector<std::string> *ret){
+	Status s = binary(false);
+	if(!s.ok()){
+		return s;
+	}
+	const std::vector<std::string> *resp;
+	resp = this->request("multi_hgetall", names);
+	return _read_list(resp, ret);
+}
+
 Status ClientImpl::multi_hset(const std::string &name, const std::unordered_map<std::string, std::string> &kvs){
 	const std::vector<std::string> *resp;
 	std::vector<std::string> list;
@@ -376,6 +429,52 @@ Status ClientImpl::multi_hdel(const std::string &name, const std::vector<std::st
 	return s;
 }
 
+Status ClientImpl::hgetall_packed(const std::string &name, std::string *packed){
+	Status s = binary(true);
+	if(!s.ok()){
+		return s;
+	}
+	const std::vector<std::string> *resp;
+	resp = this->request("hgetall", name);
+	return _read_str(resp, packed);
+}
+
+Status ClientImpl::multi_hgetall_packed(const std::vector<std::string> &names,
+	std::vector<std::string> *ret){
+	Status s = binary(true);
+	if(!s.ok()){
+		return s;
+	}
+	const std::vector<std::string> *resp;
+	resp = this->request("multi_hgetall", names);
+	return _read_list(resp, ret);
+}
+
+Status ClientImpl::multi_hget_packed(const std::string &name, const std::vector<std::string> &keys,
+	std::string *packed){
+	Status s = binary(true);
+	if(!s.ok()){
+		return s;
+	}
+	const std::vector<std::string> *resp;
+	resp = this->request("multi_hget", name, keys);
+	return _read_str(resp, packed);
+}
+
+Status ClientImpl::hscan_packed(const std::string &name,
+	const std::string &key_start, const std::string &key_end,
+	uint64_t limit, std::string *packed)
+{
+	Status s = binary(true);
+	if(!s.ok()){
+		return s;
+	}
+	std::string s_limit = str(limit);
+	const std::vector<std::string> *resp;
+	resp = this->request("hscan", name, key_start, key_end, s_limit);
+	return _read_str(resp, packed);
+}
+
 /******************** zset *************************/
 
 
@@ -12,6 +12,8 @@ private:
 	
 	Link *link;
 	std::vector<std::string> resp_;
+	bool binary_;
+	Status binary(bool on);
 public:
 	ClientImpl();
 	~ClientImpl();
@@ -53,14 +55,25 @@ public:
 	virtual Status hkeys(const std::string &name, const std::string &key_start, const std::string &key_end,
 		uint64_t limit, std::vector<std::string> *ret);
 	virtual Status hgetall(const std::string &name, std::vector<std::string> *ret);
+	virtual Status hbest(const std::string &name, int limit, int margin,
+		std::vector<std::string> *ret);
 	virtual Status hscan(const std::string &name, const std::string &key_start, const std::string &key_end,
 		uint64_t limit, std::vector<std::string> *ret);
 	virtual Status hrscan(const std::string &name, const std::string &key_start, const std::string &key_end,
 		uint64_t limit, std::vector<std::string> *ret);
 	virtual Status multi_hget(const std::string &name, const std::vector<std::string> &keys,
 		std::vector<std::string> *ret);
+	virtual Status multi_hgetall(const std::vector<std::string> &names,
+		std::vector<std::string> *ret);
 	virtual Status multi_hset(const std::string &name, const std::unordered_map<std::string, std::string> &kvs);
 	virtual Status multi_hdel(const std::string &name, const std::vector<std::string> &keys);
+	virtual Status hgetall_packed(const std::string &name, std::string *packed);
+	virtual Status multi_hgetall_packed(const std::vector<std::string> &names,
+		std::vector<std::string> *ret);
+	virtual Status multi_hget_packed(const std::string &name, const std::vector<std::string> &keys,
+		std::string *packed);
+	virtual Status hscan_packed(const std::string &name, const std::string &key_start, const std::string &key_end,
+		uint64_t limit, std::string *packed);
 
 	virtual Status zget(const std::string &name, const std::string &key, int64_t *ret);
 	virtual Status zset(const std::string &name, const std::string &key, int64_t score);
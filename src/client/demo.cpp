@@ -164,6 +164,14 @@ int main(int argc, char **argv){
 		}
 		printf("\n");
 
+		// -1: no margin filter
+		list.clear();
+		s = client->hbest(hash, 2, -1, &list);
+		assert(s.ok() && list.size() <= 4);
+		list.clear();
+		s = client->hbest(hash, 0, -1, &list);
+		assert(s.ok());
+
 		std::unordered_map<std::string, std::string> kvs;
 		kvs.insert(std::make_pair("k1", "v1"));
 		kvs.insert(std::make_pair("k2", "v2"));
@@ -0,0 +1,132 @@
+/*
+Copyright (c) 2012-2014 The SSDB Authors. All rights reserved.
+Use of this source code is governed by a BSD-style license that can be
+found in the LICENSE file.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "link.h"
+#include "../include.h"
+
+// the parse from the start Link::recv() used to do, returns the number
+// of fields of a complete request, 0 if not ready
+static int legacy_recv(Buffer *input, std::vector<Bytes> *fields){
+	fields->clear();
+	int parsed = 0;
+	int size = input->size();
+	char *head = input->data();
+	while(size > 0){
+		char *body = (char *)memchr(head, '\n', size);
+		if(body == NULL){
+			break;
+		}
+		body ++;
+		int head_len = body - head;
+		if(head_len == 1){
+			input->decr(parsed + head_len);
+			return (int)fields->size();
+		}
+		int body_len = atoi(head);
+		size -= head_len + body_len;
+		if(size < 1){
+			break;
+		}
+		fields->push_back(Bytes(body, body_len));
+		head += head_len + body_len + 1;
+		size -= 1;
+		parsed += head_len + body_len + 1;
+	}
+	fields->clear();
+	return 0;
+}
+
+static std::string random_value(){
+	char buf[4];
+	for(int i = 0; i < 4; i++){
+		buf[i] = rand() % 256;
+	}
+	return std::string(buf, 4);
+}
+
+// a multi_hset of at least mb MB
+static void make_request(int mb, std::string *ssdb, std::string *redis){
+	std::vector<std::string> args;
+	args.push_back("multi_hset");
+	args.push_back("rnbakabnr/9/1c5c1/p1p1p1p1p/9/9/P1P1P1P1P/1C5C1/9/RNBAKABNR w");
+	size_t len = 0;
+	while(len < (size_t)mb * 1024 * 1024){
+		char key[16];
+		snprintf(key, sizeof(key), "%04x", rand() % 0x10000);
+		args.push_back(key);
+		args.push_back(random_value());
+		len += strlen(key) + 4 + 8;
+	}
+	ssdb->clear();
+	redis->clear();
+	*redis += "*" + str((int)args.size()) + "\r\n";
+	for(auto &a : args){
+		*ssdb += str((int)a.size()) + "\n" + a + "\n";
+		*redis += "$" + str((int)a.size()) + "\r\n" + a + "\r\n";
+	}
+	*ssdb += "\n";
+}
+
+// feeds data in chunks like reads off a socket, returns fields parsed
+static int feed(const std::string &data, int chunk, bool legacy, double *elapsed){
+	Link link;
+	std::vector<Bytes> fields;
+	int ret = 0;
+	double stime = microtime();
+	for(size_t pos = 0; pos < data.size(); pos += chunk){
+		int n = std::min((size_t)chunk, data.size() - pos);
+		link.input->append(data.data() + pos, n);
+		if(legacy){
+			ret = legacy_recv(link.input, &fields);
+		}else{
+			const std::vector<Bytes> *req = link.recv();
+			if(req == NULL){
+				fprintf(stderr, "parse error at %d\n", (int)pos);
+				return -1;
+			}
+			ret = (int)req->size();
+		}
+		if(ret > 0){
+			break;
+		}
+	}
+	*elapsed = microtime() - stime;
+	return ret;
+}
+
+int main(int argc, char **argv){
+	int mb = 8;
+	int chunk_kb = 16;
+	if(argc > 1){
+		mb = atoi(argv[1]);
+	}
+	if(argc > 2){
+		chunk_kb = atoi(argv[2]);
+	}
+	printf("request: %d MB, chunk: %d KB\n", mb, chunk_kb);
+
+	srand(1);
+	std::string ssdb, redis;
+	make_request(mb, &ssdb, &redis);
+
+	int chunk = chunk_kb * 1024;
+	double time;
+	int mismatch = 0;
+	int fields = feed(ssdb, chunk, true, &time);
+	printf("legacy: %8.3f ms, %d fields\n", time * 1000, fields);
+	int n = feed(ssdb, chunk, false, &time);
+	printf("ssdb  : %8.3f ms, %d fields\n", time * 1000, n);
+	mismatch += (n != fields);
+	n = feed(redis, chunk, false, &time);
+	printf("redis : %8.3f ms, %d fields\n", time * 1000, n);
+	mismatch += (n != fields);
+	printf("mismatch: %d\n", mismatch);
+	return mismatch? 1 : 0;
+}
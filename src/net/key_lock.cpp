@@ -0,0 +1,95 @@
+/*
+Copyright (c) 2012-2014 The SSDB Authors. All rights reserved.
+Use of this source code is governed by a BSD-style license that can be
+found in the LICENSE file.
+*/
+#include <algorithm>
+#include "key_lock.h"
+
+KeyLocks::KeyLocks(){
+	pthread_rwlockattr_t attr;
+	pthread_rwlockattr_init(&attr);
+	// a hot key written blindly must not starve its read-modify-writes
+	pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+	for(int i = 0; i < STRIPES; i++){
+		pthread_rwlock_init(&locks[i].lock, &attr);
+	}
+	pthread_rwlockattr_destroy(&attr);
+	canonical = NULL;
+	canonical_data = NULL;
+}
+
+KeyLocks::~KeyLocks(){
+	for(int i = 0; i < STRIPES; i++){
+		pthread_rwlock_destroy(&locks[i].lock);
+	}
+}
+
+void KeyLocks::set_canonical(canonical_t fn, void *data){
+	canonical = fn;
+	canonical_data = data;
+}
+
+int KeyLocks::stripe(const Bytes &key){
+	const char *p = key.data();
+	int size = key.size();
+	std::string buf;
+	if(canonical){
+		canonical(canonical_data, key, &buf);
+		p = buf.data();
+		size = buf.size();
+	}
+	// FNV-1a
+	uint64_t h = 14695981039346656037ULL;
+	for(int i = 0; i < size; i++){
+		h = (h ^ (unsigned char)p[i]) * 1099511628211ULL;
+	}
+	return (int)(h % STRIPES);
+}
+
+void KeyLocks::stripes(const Command *cmd, const Request &req, std::vector<int> *out){
+	out->clear();
+	if(req.size() < 2){
+		return;
+	}
+	if(cmd->key_step == 0){
+		out->push_back(stripe(req[1]));
+		return;
+	}
+	for(int i = 1; i < (int)req.size(); i += cmd->key_step){
+		out->push_back(stripe(req[i]));
+	}
+	std::sort(out->begin(), out->end());
+	out->erase(std::unique(out->begin(), out->end()), out->end());
+}
+
+void KeyLocks::lock(const std::vector<int> &stripes, bool exclusive){
+	for(int i : stripes){
+		if(exclusive){
+			pthread_rwlock_wrlock(&locks[i].lock);
+		}else{
+			pthread_rwlock_rdlock(&locks[i].lock);
+		}
+	}
+}
+
+void KeyLocks::unlock(const std::vector<int> &stripes){
+	for(int i : stripes){
+		pthread_rwlock_unlock(&locks[i].lock);
+	}
+}
+
+WriteLock::WriteLock(KeyLocks *locks, const Command *cmd, const Request &req){
+	this->locks = locks;
+	if(cmd->flags & Command::FLAG_GLOBAL){
+		global.acquire(g_proc_mutex);
+		return;
+	}
+	global.acquire(g_proc_mutex, false);
+	locks->stripes(cmd, req, &stripes);
+	locks->lock(stripes, cmd->flags & Command::FLAG_BLOCK);
+}
+
+WriteLock::~WriteLock(){
+	locks->unlock(stripes);
+}
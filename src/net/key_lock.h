@@ -0,0 +1,64 @@
+/*
+Copyright (c) 2012-2014 The SSDB Authors. All rights reserved.
+Use of this source code is governed by a BSD-style license that can be
+found in the LICENSE file.
+*/
+#ifndef NET_KEY_LOCK_H_
+#define NET_KEY_LOCK_H_
+
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include <tbb/queuing_rw_mutex.h>
+#include "proc.h"
+
+extern tbb::queuing_rw_mutex g_proc_mutex;
+
+// Read-write locks striped by the keys a write command declares. Blind
+// writes share the stripes of their keys, read-modify-write ("b")
+// commands hold them exclusively. Stripes are taken in index order, so
+// multi-key commands can't deadlock.
+class KeyLocks
+{
+public:
+	typedef void (*canonical_t)(void *data, const Bytes &key, std::string *out);
+
+	KeyLocks();
+	~KeyLocks();
+	// keys stored under the same name must lock the same stripe
+	void set_canonical(canonical_t fn, void *data);
+	// sorted unique stripes of the keys cmd writes
+	void stripes(const Command *cmd, const Request &req, std::vector<int> *out);
+	void lock(const std::vector<int> &stripes, bool exclusive);
+	void unlock(const std::vector<int> &stripes);
+
+private:
+	static const int STRIPES = 1024;
+	struct alignas(64) Stripe{
+		pthread_rwlock_t lock;
+	};
+	Stripe locks[STRIPES];
+	canonical_t canonical;
+	void *canonical_data;
+
+	int stripe(const Bytes &key);
+};
+
+// Held while a write command runs. Whole-db ("g") commands take the
+// global lock exclusively, other writes share it and lock their keys.
+class WriteLock
+{
+public:
+	WriteLock(KeyLocks *locks, const Command *cmd, const Request &req);
+	~WriteLock();
+
+private:
+	tbb::queuing_rw_mutex::scoped_lock global;
+	KeyLocks *locks;
+	std::vector<int> stripes;
+	// No copying allowed
+	WriteLock(const WriteLock&);
+	void operator=(const WriteLock&);
+};
+
+#endif
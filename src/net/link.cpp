@@ -23,12 +23,14 @@ static std::atomic<uint64_t> g_next_gen{ 1 };
 
 Link::Link(bool is_server){
 	redis = NULL;
+	recv_parsed = 0;
 	sock = -1;
 	noblock_ = false;
 	error_ = false;
 	remote_ip[0] = '\0';
 	remote_port = -1;
 	auth = false;
+	binary = false;
 	
 	if(is_server){
 		input = output = NULL;
@@ -333,35 +335,41 @@ const std::vector<Bytes>* Link::recv(){
 		return &this->recv_data;
 	}
 
-	// TODO: 记住上回的解析状态
-	int parsed = 0;
+	int parsed = this->recv_parsed;
 	int size = input->size();
-	char *head = input->data();
+	char *data = input->data();
 
-	// ignore leading empty lines
-	while(size > 0 && (head[0] == '\n' || head[0] == '\r')){
-		head ++;
-		size --;
-		parsed ++;
-	}
-	
-	// Redis protocol supports
-	if(size > 0 && head[0] == '*'){
-		if(redis == NULL){
-			redis = new RedisLink();
+	if(recv_fields.empty()){
+		// ignore leading empty lines
+		while(parsed < size && (data[parsed] == '\n' || data[parsed] == '\r')){
+			parsed ++;
 		}
-		const std::vector<Bytes> *ret = redis->recv_req(input);
-		if(ret){
-			this->recv_data = *ret;
-			return &this->recv_data;
-		}else{
-			return NULL;
+		// Redis protocol supports
+		if(parsed < size && data[parsed] == '*'){
+			if(redis == NULL){
+				redis = new RedisLink();
+			}
+			this->recv_parsed = 0;
+			const std::vector<Bytes> *ret = redis->recv_req(input);
+			if(ret){
+				this->recv_data = *ret;
+				return &this->recv_data;
+			}else{
+				return NULL;
+			}
 		}
 	}
 
-	while(size > 0){
-		char *body = (char *)memchr(head, '\n', size);
+	char head_str[20];
+	while(parsed < size){
+		char *head = data + parsed;
+		int left = size - parsed;
+		// a head is a short number, don't scan a body for its end
+		char *body = (char *)memchr(head, '\n', std::min(left, (int)sizeof(head_str)));
 		if(body == NULL){
+			if(left >= (int)sizeof(head_str)){
+				return NULL;
+			}
 			break;
 		}
 		body ++;
@@ -369,8 +377,12 @@ const std::vector<Bytes>* Link::recv(){
 		int head_len = body - head;
 		if(head_len == 1 || (head_len == 2 && head[0] == '\r')){
 			// packet end
-			parsed += head_len;
-			input->decr(parsed);
+			for(auto &f : recv_fields){
+				this->recv_data.push_back(Bytes(data + f.first, f.second));
+			}
+			input->decr(parsed + head_len);
+			this->recv_parsed = 0;
+			this->recv_fields.clear();
 			return &this->recv_data;
 		}
 		if(head[0] < '0' || head[0] > '9'){
@@ -378,10 +390,6 @@ const std::vector<Bytes>* Link::recv(){
 			return NULL;
 		}
 
-		char head_str[20];
-		if(head_len > (int)sizeof(head_str) - 1){
-			return NULL;
-		}
 		memcpy(head_str, head, head_len - 1); // no '\n'
 		head_str[head_len - 1] = '\0';
 
@@ -391,34 +399,28 @@ const std::vector<Bytes>* Link::recv(){
 			return NULL;
 		}
 		//log_debug("size: %d, head_len: %d, body_len: %d", size, head_len, body_len);
-		size -= head_len + body_len;
-		if(size < 0){
+		int end = parsed + head_len + body_len;
+		if(end > size){
 			break;
 		}
-
-		this->recv_data.push_back(Bytes(body, body_len));
-
-		head += head_len + body_len;
-		parsed += head_len + body_len;
-		if(size >= 1 && head[0] == '\n'){
-			head += 1;
-			size -= 1;
-			parsed += 1;
-		}else if(size >= 2 && head[0] == '\r' && head[1] == '\n'){
-			head += 2;
-			size -= 2;
-			parsed += 2;
-		}else if(size >= 2){
+		if(end + 1 <= size && data[end] == '\n'){
+			end += 1;
+		}else if(end + 2 <= size && data[end] == '\r' && data[end + 1] == '\n'){
+			end += 2;
+		}else if(end + 2 <= size){
 			// bad format
 			return NULL;
 		}else{
 			break;
 		}
+		this->recv_fields.push_back(std::make_pair(parsed + head_len, body_len));
+		parsed = end;
 		if(parsed > MAX_PACKET_SIZE){
 			 //log_warn("fd: %d, exceed max packet size, parsed: %d", this->sock, parsed);
 			 return NULL;
 		}
 	}
+	this->recv_parsed = parsed;
 
 	if(input->space() == 0){
 		input->nice();
@@ -432,7 +434,6 @@ const std::vector<Bytes>* Link::recv(){
 	}
 
 	// not ready
-	this->recv_data.clear();
 	return &this->recv_data;
 }
 
@@ -7,6 +7,7 @@ found in the LICENSE file.
 #define NET_LINK_H_
 
 #include <vector>
+#include <utility>
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
@@ -25,6 +26,10 @@ class Link{
 		short family;
 		bool ipv4;
 		std::vector<Bytes> recv_data;
+		// recv() resumes after the fields of the request parsed so far,
+		// kept as offsets from input->data() which may be moved
+		int recv_parsed;
+		std::vector<std::pair<int, int>> recv_fields;
 
 		RedisLink *redis;
 	public:
@@ -34,6 +39,8 @@ class Link{
 		int remote_port;
 
 		bool auth;
+		// reply chess hash reads with packed entries
+		bool binary;
 
 		Buffer *input;
 		Buffer *output;
@@ -96,6 +96,7 @@ static RedisCommand_raw cmds_raw[] = {
 	{STRATEGY_HMGET, "hmget",	"multi_hget",	REPLY_MULTI_BULK},
 	
 	{STRATEGY_HGETALL,	"hgetall",		"hgetall",		REPLY_MULTI_BULK},
+	{STRATEGY_AUTO,		"hbest",		"hbest",		REPLY_MULTI_BULK},
 	{STRATEGY_HKEYS,	"hkeys", 		"hkeys", 		REPLY_MULTI_BULK},
 	{STRATEGY_HVALS,	"hvals", 		"hvals", 		REPLY_MULTI_BULK},
 	{STRATEGY_SETEX,	"setex",		"setx", 		REPLY_STATUS},
@@ -505,37 +506,39 @@ int RedisLink::send_resp(Buffer *output, const std::vector<std::string> &resp){
 int RedisLink::parse_req(Buffer *input){
 	recv_bytes.clear();
 
-	int parsed = 0;
 	int size = input->size();
-	char *ptr = input->data();
+	char *data = input->data();
 	
-	// ignore leading empty lines
-	while(size > 0 && (ptr[0] == '\n' || ptr[0] == '\r')){
-		ptr ++;
-		size --;
-		parsed ++;
-	}
-	//dump(ptr, size);
-	
-	if(size == 0 || ptr[0] != '*'){
-		return -1;
+	if(num_args == 0){
+		parsed = 0;
+		// ignore leading empty lines
+		while(parsed < size && (data[parsed] == '\n' || data[parsed] == '\r')){
+			parsed ++;
+		}
+		//dump(data + parsed, size - parsed);
+		if(parsed == size || data[parsed] != '*'){
+			return -1;
+		}
 	}
 
-	int num_args = 0;	
-	while(size > 0){
-		char *lf = (char *)memchr(ptr, '\n', size);
+	while(parsed < size){
+		char *ptr = data + parsed;
+		int left = size - parsed;
+		// '*' or '$' and a number, don't scan a bulk for its end
+		char *lf = (char *)memchr(ptr, '\n', std::min(left, 32));
 		if(lf == NULL){
+			if(left >= 32){
+				return -1;
+			}
 			break;
 		}
 		lf += 1;
-		size -= (lf - ptr);
-		parsed += (lf - ptr);
 		
+		errno = 0;
 		int len = (int)strtol(ptr + 1, NULL, 10); // ptr + 1: skip '$' or '*'
 		if(errno == EINVAL){
 			return -1;
 		}
-		ptr = lf;
 		if(len < 0){
 			return -1;
 		}
@@ -544,32 +547,37 @@ int RedisLink::parse_req(Buffer *input){
 				return -1;
 			}
 			num_args = len;
+			parsed += lf - ptr;
 			continue;
 		}
 		
-		if(len > size - 1){
+		int start = parsed + (lf - ptr);
+		int end = start + len;
+		// compatiabl with both CRLF and LF
+		if(end + 1 <= size && data[end] == '\n'){
+			end += 1;
+		}else if(end + 2 <= size && data[end] == '\r' && data[end + 1] == '\n'){
+			end += 2;
+		}else if(end + 2 <= size){
+			return -1;
+		}else{
 			break;
 		}
 		
-		recv_bytes.push_back(Bytes(ptr, len));
-		
-		ptr += len + 1;
-		size -= len + 1;
-		parsed += len + 1;
-		// compatiabl with both CRLF and LF
-		if(size > 0 && *ptr == '\n'){
-			ptr += 1;
-			size -= 1;
-			parsed += 1;
-		}
+		args.push_back(std::make_pair(start, len));
+		parsed = end;
 
-		num_args --;
-		if(num_args == 0){
+		if((int)args.size() == num_args){
+			for(auto &a : args){
+				recv_bytes.push_back(Bytes(data + a.first, a.second));
+			}
 			input->decr(parsed);
+			parsed = 0;
+			num_args = 0;
+			args.clear();
 			return 1;
 		}
 	}
 	
-	recv_bytes.clear();
 	return 0;
 }
@@ -8,6 +8,7 @@ found in the LICENSE file.
 
 #include <vector>
 #include <string>
+#include <utility>
 #include "../util/bytes.h"
 
 struct RedisRequestDesc
@@ -26,12 +27,19 @@ private:
 
 	std::vector<Bytes> recv_bytes;
 	std::vector<std::string> recv_string;
+	// parse_req() resumes after the args parsed so far, offsets from
+	// input->data()
+	int parsed;
+	int num_args;
+	std::vector<std::pair<int, int>> args;
 	int parse_req(Buffer *input);
 	int convert_req();
 	
 public:
 	RedisLink(){
 		req_desc = NULL;
+		parsed = 0;
+		num_args = 0;
 	}
 	static void init();
 
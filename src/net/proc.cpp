@@ -22,7 +22,7 @@ void ProcMap::set_proc(const std::string &c, void* proc){
 	this->set_proc(c, "t", proc);
 }
 
-void ProcMap::set_proc(const std::string &c, const char *sflags, void* proc){
+void ProcMap::set_proc(const std::string &c, const char *sflags, void* proc, int lane){
 	Command *cmd = this->get_proc(c);
 	if(!cmd){
 		cmd = new Command();
@@ -30,8 +30,14 @@ void ProcMap::set_proc(const std::string &c, const char *sflags, void* proc){
 		proc_map[cmd->name] = cmd;
 	}
 	cmd->proc = proc;
+	cmd->lane = (lane >= 0 && lane < Command::LANES)? lane : Command::LANE_FAST;
 	cmd->flags = 0;
+	cmd->key_step = 0;
 	for(const char *p=sflags; *p!='\0'; p++){
+		if(*p >= '1' && *p <= '9'){
+			cmd->key_step = *p - '0';
+			continue;
+		}
 		switch(*p){
 			case 'r':
 				cmd->flags |= Command::FLAG_READ;
@@ -51,6 +57,9 @@ void ProcMap::set_proc(const std::string &c, const char *sflags, void* proc){
 			case 'l':
 				cmd->flags |= Command::FLAG_LINK;
 				break;
+			case 'g':
+				cmd->flags |= Command::FLAG_GLOBAL;
+				break;
 		}
 	}
 }
@@ -34,14 +34,26 @@ struct Command{
 	static const int FLAG_THREAD		= (1 << 3);
 	static const int FLAG_LINK			= (1 << 4);
 	static const int FLAG_THREAD_SOFT	= (1 << 5);
+	static const int FLAG_GLOBAL		= (1 << 6);
+
+	// worker pool threaded commands run in
+	static const int LANE_FAST			= 0;
+	static const int LANE_SCAN			= 1;
+	static const int LANE_ADMIN			= 2;
+	static const int LANES				= 3;
 
 	std::string name;
 	int flags;
+	int lane;
+	// keys a write locks are req[1], req[1 + key_step]..., only req[1] if 0
+	int key_step;
 	void* proc;
 	std::atomic<uint64_t> calls;
 
 	Command(){
 		flags = 0;
+		lane = LANE_FAST;
+		key_step = 0;
 		proc = NULL;
 		calls.store(0, std::memory_order_relaxed);
 	}
@@ -68,7 +80,7 @@ private:
 public:
 	ProcMap();
 	~ProcMap();
-	void set_proc(const std::string &cmd, const char *sflags, void* proc);
+	void set_proc(const std::string &cmd, const char *sflags, void* proc, int lane=Command::LANE_FAST);
 	void set_proc(const std::string &cmd, void* proc);
 	Command* get_proc(const Bytes &str);
 
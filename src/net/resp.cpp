@@ -15,6 +15,10 @@ void Response::push_back(const std::string &s){
 	resp.push_back(s);
 }
 
+void Response::push_back(std::string &&s){
+	resp.push_back(std::move(s));
+}
+
 void Response::add(int s){
 	add((int64_t)s);
 }
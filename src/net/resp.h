@@ -15,9 +15,14 @@ class Response
 {
 public:
 	std::vector<std::string> resp;
+	// the requesting link is in binary mode
+	bool binary;
+
+	Response() : binary(false) {}
 
 	int size() const;
 	void push_back(const std::string &s);
+	void push_back(std::string &&s);
 	void add(int s);
 	void add(int64_t s);
 	void add(uint64_t s);
@@ -14,11 +14,16 @@ found in the LICENSE file.
 #include <unordered_map>
 #include <tbb/queuing_rw_mutex.h>
 
+// defaults of server.threads and server.workers
+#define SERVE_THREADS	32
+#define WORKER_THREADS	16
+
 Mutex g_ip_filter_mutex;
 tbb::queuing_rw_mutex g_proc_mutex;
 
 static DEF_PROC(ping);
 static DEF_LINK_PROC(auth);
+static DEF_LINK_PROC(binary);
 static DEF_LINK_PROC(list_allow_ip);
 static DEF_LINK_PROC(add_allow_ip);
 static DEF_LINK_PROC(del_allow_ip);
@@ -26,8 +31,6 @@ static DEF_LINK_PROC(list_deny_ip);
 static DEF_LINK_PROC(add_deny_ip);
 static DEF_LINK_PROC(del_deny_ip);
 
-#define WORKER_THREADS 16
-
 volatile bool quit = false;
 
 void signal_handler(int sig){
@@ -42,9 +45,39 @@ void signal_handler(int sig){
 }
 
 NetworkServer::NetworkServer(const Config &conf) {
-	memset(link_count, 0, sizeof(link_count));
-	memset(link_count_unix, 0, sizeof(link_count_unix));
-	memset(handoff_efd, 0, sizeof(handoff_efd));
+	serve_threads = conf.get_num("server.threads");
+	if(serve_threads <= 0){
+		serve_threads = SERVE_THREADS;
+	}
+	worker_threads = conf.get_num("server.workers");
+	if(worker_threads <= 0){
+		worker_threads = WORKER_THREADS;
+	}
+	std::string affinity_str = conf.get_str("server.cpu_affinity");
+	strtolower(&affinity_str);
+	cpu_affinity = (affinity_str == "yes");
+	// threads are pinned within the cores the process was started on,
+	// taken here on the main thread before any is pinned
+	cpus = process_cpus();
+	// scans and admin commands get their own workers, so they can't
+	// hold up the fast lane
+	lane_threads[Command::LANE_FAST] = worker_threads;
+	lane_threads[Command::LANE_SCAN] = conf.get_num("server.scan_workers");
+	if(lane_threads[Command::LANE_SCAN] <= 0){
+		lane_threads[Command::LANE_SCAN] = std::max(1, worker_threads / 4);
+	}
+	lane_threads[Command::LANE_ADMIN] = conf.get_num("server.admin_workers");
+	if(lane_threads[Command::LANE_ADMIN] <= 0){
+		lane_threads[Command::LANE_ADMIN] = 1;
+	}
+	log_info("    threads : %d, workers: %d, scan_workers: %d, admin_workers: %d, cpu_affinity: %s",
+		serve_threads, worker_threads, lane_threads[Command::LANE_SCAN], lane_threads[Command::LANE_ADMIN],
+		cpu_affinity? "yes" : "no");
+
+	link_count = new int[serve_threads]();
+	link_count_unix = new int[serve_threads]();
+	handoff_efd = new int[serve_threads]();
+	handoff_queue = new Queue<Link*>[serve_threads];
 	serve_max = 0;
 	serve_accept = 0;
 
@@ -55,6 +88,7 @@ NetworkServer::NetworkServer(const Config &conf) {
 	// add built-in procs, can be overridden
 	proc_map.set_proc("ping", "r", (void*)proc_ping);
 	proc_map.set_proc("auth", "l", (void*)proc_auth);
+	proc_map.set_proc("binary", "l", (void*)proc_binary);
 	proc_map.set_proc("list_allow_ip", "l", (void*)proc_list_allow_ip);
 	proc_map.set_proc("add_allow_ip",  "l", (void*)proc_add_allow_ip);
 	proc_map.set_proc("del_allow_ip",  "l", (void*)proc_del_allow_ip);
@@ -144,14 +178,22 @@ NetworkServer::NetworkServer(const Config &conf) {
 	log_info("    readonly: %s", readonly_str.c_str());
 
 	RedisLink::init();
-	workers = new ProcWorkerPool("workers");
+	lanes[Command::LANE_FAST] = new ProcWorkerPool("fast");
+	lanes[Command::LANE_SCAN] = new ProcWorkerPool("scan");
+	lanes[Command::LANE_ADMIN] = new ProcWorkerPool("admin");
 }
 	
 NetworkServer::~NetworkServer(){
 	delete serv_sock;
 	unlink(sock_path);
-	delete workers;
+	for(int i = 0; i < Command::LANES; i++){
+		delete lanes[i];
+	}
 	delete ip_filter;
+	delete[] link_count;
+	delete[] link_count_unix;
+	delete[] handoff_efd;
+	delete[] handoff_queue;
 }
 
 void *NetworkServer::serve(void *arg){
@@ -165,6 +207,12 @@ void *NetworkServer::serve(void *arg){
 
 	NetworkServer *net = (NetworkServer*)arg;
 	int serve_idx = __sync_fetch_and_add(&net->serve_max, 1);
+	if(net->cpu_affinity){
+		// before anything is allocated, so the pages of this thread's
+		// events and queues are first touched on its own NUMA node
+		int cpu = pin_thread(net->cpus, serve_idx);
+		log_debug("serve thread %d on cpu %d", serve_idx, cpu);
+	}
 	int write_efd = eventfd(0, EFD_NONBLOCK);
 	int handoff_efd = eventfd(0, EFD_NONBLOCK);
 	net->handoff_efd[serve_idx] = handoff_efd;
@@ -181,7 +229,13 @@ void *NetworkServer::serve(void *arg){
 	fdes->set(net->serv_sock->fd(), FDEVENT_IN, 0, net->serv_sock);
 	fdes->set(write_efd, FDEVENT_IN, 0, NULL);
 	fdes->set(handoff_efd, FDEVENT_IN, 0, NULL);
-	net->workers->start(WORKER_THREADS);
+	{
+		int first_cpu = net->serve_threads;
+		for(int i = 0; i < Command::LANES; i++){
+			net->lanes[i]->start(net->lane_threads[i], net->cpu_affinity? net->cpus : NULL, first_cpu);
+			first_cpu += net->lane_threads[i];
+		}
+	}
 	while(!quit){
 
 		ready_list.swap(ready_list_2);
@@ -228,19 +282,19 @@ void *NetworkServer::serve(void *arg){
 							handoff = true;
 							int min_idx = serve_idx;
 							int *pcount = (link->remote_port != 0) ? net->link_count : net->link_count_unix;
-							int cnt = pcount[serve_idx % SERVE_THREADS] - 1;
+							int cnt = pcount[serve_idx % net->serve_threads] - 1;
 							for(int j = 1; j < net->serve_max; j++){
 								int idx = (serve_idx + j) % net->serve_max;
-								if(net->handoff_efd[idx] > 0 && pcount[idx % SERVE_THREADS] < cnt){
+								if(net->handoff_efd[idx] > 0 && pcount[idx % net->serve_threads] < cnt){
 									min_idx = idx;
 									break;
 								}
 							}
 							if(min_idx != serve_idx){
 								if(link->remote_port != 0)
-									__sync_sub_and_fetch(&net->link_count[serve_idx % SERVE_THREADS], 1);
+									__sync_sub_and_fetch(&net->link_count[serve_idx % net->serve_threads], 1);
 								else
-									__sync_sub_and_fetch(&net->link_count_unix[serve_idx % SERVE_THREADS], 1);
+									__sync_sub_and_fetch(&net->link_count_unix[serve_idx % net->serve_threads], 1);
 								// proc_result clears OUT when link->output->empty(), and IN was cleared before
 								// handing the request to a worker, so this fd is already removed from this poller.
 								//fdes->del(link->fd());
@@ -261,9 +315,9 @@ void *NetworkServer::serve(void *arg){
 				while(net->handoff_queue[serve_idx].pop(&link)){
 					conns.emplace(link->fd(), link);
 					if(link->remote_port != 0)
-						__sync_add_and_fetch(&net->link_count[serve_idx % SERVE_THREADS], 1);
+						__sync_add_and_fetch(&net->link_count[serve_idx % net->serve_threads], 1);
 					else
-						__sync_add_and_fetch(&net->link_count_unix[serve_idx % SERVE_THREADS], 1);
+						__sync_add_and_fetch(&net->link_count_unix[serve_idx % net->serve_threads], 1);
 					fdes->set(link->fd(), FDEVENT_IN, 1, link);
 					if(!link->input->empty())
 						ready_list.push_back(link);
@@ -272,7 +326,7 @@ void *NetworkServer::serve(void *arg){
 				Link* link;
 				while((link = net->accept_link(serv_link))) {
 					conns.emplace(link->fd(), link);
-					int cur = __sync_add_and_fetch(&net->link_count[serve_idx % SERVE_THREADS], 1);
+					int cur = __sync_add_and_fetch(&net->link_count[serve_idx % net->serve_threads], 1);
 					log_debug("new link from %s:%d, fd: %d, links: %d",
 						link->remote_ip, link->remote_port, link->fd(), cur);
 					fdes->set(link->fd(), FDEVENT_IN, 1, link);
@@ -282,15 +336,15 @@ void *NetworkServer::serve(void *arg){
 					Link* link = net->accept_link(net->serv_sock);
 					if(link) {
 						conns.emplace(link->fd(), link);
-						int cur = __sync_add_and_fetch(&net->link_count_unix[serve_idx % SERVE_THREADS], 1);
+						int cur = __sync_add_and_fetch(&net->link_count_unix[serve_idx % net->serve_threads], 1);
 						log_debug("new link from %s:%d, fd: %d, links: %d",
 							link->remote_ip, link->remote_port, link->fd(), cur);
 						fdes->set(link->fd(), FDEVENT_IN, 1, link);
 						int next_serve_accept = (serve_idx + 1) % net->serve_max;
-						int min_link_count = net->link_count_unix[(serve_idx + 1) % SERVE_THREADS];
+						int min_link_count = net->link_count_unix[(serve_idx + 1) % net->serve_threads];
 						for(int j = 1; j < net->serve_max; j++) {
-							if(net->link_count_unix[(serve_idx + j) % SERVE_THREADS] < min_link_count) {
-								min_link_count = net->link_count_unix[(serve_idx + j) % SERVE_THREADS];
+							if(net->link_count_unix[(serve_idx + j) % net->serve_threads] < min_link_count) {
+								min_link_count = net->link_count_unix[(serve_idx + j) % net->serve_threads];
 								next_serve_accept = (serve_idx + j) % net->serve_max;
 							}
 						}
@@ -309,9 +363,9 @@ void *NetworkServer::serve(void *arg){
 
 			if(link->error()){
 				if(link->remote_port != 0)
-					__sync_sub_and_fetch(&net->link_count[serve_idx % SERVE_THREADS], 1);
+					__sync_sub_and_fetch(&net->link_count[serve_idx % net->serve_threads], 1);
 				else
-					__sync_sub_and_fetch(&net->link_count_unix[serve_idx % SERVE_THREADS], 1);
+					__sync_sub_and_fetch(&net->link_count_unix[serve_idx % net->serve_threads], 1);
 				fdes->del(link->fd());
 				conns.erase(link->fd());
 				delete link;
@@ -345,9 +399,9 @@ void *NetworkServer::serve(void *arg){
 				}else if(result == PROC_BACKEND){
 					// link_count does not include backend links
 					if(link->remote_port != 0)
-						__sync_sub_and_fetch(&net->link_count[serve_idx % SERVE_THREADS], 1);
+						__sync_sub_and_fetch(&net->link_count[serve_idx % net->serve_threads], 1);
 					else
-						__sync_sub_and_fetch(&net->link_count_unix[serve_idx % SERVE_THREADS], 1);
+						__sync_sub_and_fetch(&net->link_count_unix[serve_idx % net->serve_threads], 1);
 					fdes->del(link->fd());
 					conns.erase(link->fd());
 					break;
@@ -360,16 +414,18 @@ void *NetworkServer::serve(void *arg){
 			elem.first->calls.fetch_add(elem.second, std::memory_order_relaxed);
 		}
 	}
-	net->workers->stop();
+	for(int i = 0; i < Command::LANES; i++){
+		net->lanes[i]->stop();
+	}
 	{
 		Link* link;
 		std::unordered_map<int, Link*>::iterator iter = conns.begin();
 		while(iter != conns.end()) {
 			link = iter->second;
 			if(link->remote_port != 0)
-				__sync_sub_and_fetch(&net->link_count[serve_idx % SERVE_THREADS], 1);
+				__sync_sub_and_fetch(&net->link_count[serve_idx % net->serve_threads], 1);
 			else
-				__sync_sub_and_fetch(&net->link_count_unix[serve_idx % SERVE_THREADS], 1);
+				__sync_sub_and_fetch(&net->link_count_unix[serve_idx % net->serve_threads], 1);
 			fdes->del(link->fd());
 			delete link;
 			iter++;
@@ -389,6 +445,21 @@ void *NetworkServer::serve(void *arg){
 	return NULL;
 }
 
+std::vector<std::string> NetworkServer::lane_stats(){
+	std::vector<std::string> ret;
+	for(int i = 0; i < Command::LANES; i++){
+		ProcWorkerPool *pool = lanes[i];
+		std::string s;
+		s.append("    workers  : " + str(pool->size()) + "\n");
+		s.append("    queued   : " + str(pool->queue_size()) + "\n");
+		s.append("    peak     : " + str(pool->reset_peak()) + "\n");
+		s.append("    jobs     : " + str(pool->job_count()) + "");
+		ret.push_back(pool->get_name());
+		ret.push_back(s);
+	}
+	return ret;
+}
+
 Link* NetworkServer::accept_link(Link* serv_link){
 	Link* link = serv_link->accept();
 	if(link == NULL){
@@ -456,6 +527,7 @@ int NetworkServer::proc(ProcJob *job, Link* link, bool backlogged){
 	job->serv = this;
 	job->result = PROC_OK;
 	job->req = link->last_recv();
+	job->resp.binary = link->binary;
 
 	const Request *req = job->req;
 
@@ -490,17 +562,12 @@ int NetworkServer::proc(ProcJob *job, Link* link, bool backlogged){
 
 		if(job->cmd->flags & Command::FLAG_THREAD
 			|| ((job->cmd->flags & Command::FLAG_THREAD_SOFT) && backlogged)){
-			workers->push(*job);
+			lanes[job->cmd->lane]->push(*job);
 			return PROC_THREAD;
 		}
 		proc_t p = (proc_t)job->cmd->proc;
 		if(job->cmd->flags & Command::FLAG_WRITE) {
-			tbb::queuing_rw_mutex::scoped_lock m_lock;
-			if(job->cmd->flags & Command::FLAG_BLOCK) {
-				m_lock.acquire(g_proc_mutex);
-			} else {
-				m_lock.acquire(g_proc_mutex, false);
-			}
+			WriteLock lock(&key_locks, job->cmd, *req);
 			job->result = (*p)(this, *req, &job->resp);
 		} else {
 			job->result = (*p)(this, *req, &job->resp);
@@ -544,6 +611,29 @@ static int proc_auth(NetworkServer *net, Link *link, const Request &req, Respons
 	return 0;
 }
 
+static int proc_binary(NetworkServer *net, Link *link, const Request &req, Response *resp){
+	if(req.size() > 2){
+		resp->push_back("client_error");
+		return 0;
+	}
+	if(req.size() == 2){
+		std::string mode = req[1].String();
+		strtolower(&mode);
+		if(mode == "on" || mode == "1"){
+			link->binary = true;
+		}else if(mode == "off" || mode == "0"){
+			link->binary = false;
+		}else{
+			resp->push_back("client_error");
+			resp->push_back("usage: binary [on|off]");
+			return 0;
+		}
+	}
+	resp->push_back("ok");
+	resp->push_back(link->binary? "1" : "0");
+	return 0;
+}
+
 #define ENSURE_LOCALHOST() do{ \
 		if(strcmp(link->remote_ip, "127.0.0.1") != 0 \
 			&& strcmp(link->remote_ip, "::1") != 0) \
@@ -14,12 +14,8 @@ found in the LICENSE file.
 #include "fde.h"
 #include "proc.h"
 #include "worker.h"
+#include "key_lock.h"
 #include "../util/thread.h"
-#include <tbb/queuing_rw_mutex.h>
-
-extern tbb::queuing_rw_mutex g_proc_mutex;
-
-#define SERVE_THREADS 32
 
 class Link;
 class Config;
@@ -36,7 +32,9 @@ private:
 	void proc_client_event(Fdevents *fdes, const Fdevent *fde, ready_list_t *ready_list);
 	int proc(ProcJob *job, Link* link, bool backlogged);
 
-	ProcWorkerPool *workers;
+	// one pool per Command lane
+	ProcWorkerPool *lanes[Command::LANES];
+	int lane_threads[Command::LANES];
 	bool readonly;
 	const char *sock_path;
 
@@ -49,10 +47,19 @@ public:
 	static void *serve(void *arg);
 	void *data;
 	ProcMap proc_map;
-	int link_count[SERVE_THREADS];
-	int link_count_unix[SERVE_THREADS];
-	int handoff_efd[SERVE_THREADS];
-	Queue<Link*, (1 << 16)> handoff_queue[SERVE_THREADS];
+	KeyLocks key_locks;
+	// server.threads and server.workers, default to 32 and 16
+	int serve_threads;
+	int worker_threads;
+	// name, stats pairs of worker lanes
+	std::vector<std::string> lane_stats();
+	// pin serve threads, then workers, one per core
+	bool cpu_affinity;
+	const cpu_set_t *cpus;
+	int *link_count;
+	int *link_count_unix;
+	int *handoff_efd;
+	Queue<Link*> *handoff_queue;
 	volatile int serve_max;
 	volatile int serve_accept;
 	IpFilter *ip_filter;
@@ -22,12 +22,7 @@ void ProcWorker::proc(ProcJob* job){
 	const Request *req = job->req;
 	proc_t p = (proc_t)job->cmd->proc;
 	if(job->cmd->flags & Command::FLAG_WRITE){
-		tbb::queuing_rw_mutex::scoped_lock m_lock;
-		if(job->cmd->flags & Command::FLAG_BLOCK){
-			m_lock.acquire(g_proc_mutex);
-		} else {
-			m_lock.acquire(g_proc_mutex, false);
-		}
+		WriteLock lock(&job->serv->key_locks, job->cmd, *req);
 		job->result = (*p)(job->serv, *req, &job->resp);
 	} else {
 		job->result = (*p)(job->serv, *req, &job->resp);
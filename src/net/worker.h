@@ -19,7 +19,7 @@ struct ProcJob{
 
 	const Request *req;
 	Response resp;
-	Queue<ProcJob, (1 << 16)>* wq;
+	Queue<ProcJob>* wq;
 	int efd;
 	void enqueue_write() {
 		wq->push(std::move(*this));
@@ -27,7 +27,7 @@ struct ProcJob{
 	}
 };
 
-typedef Queue<ProcJob, (1 << 16)> WriteQueue;
+typedef Queue<ProcJob> WriteQueue;
 
 class ProcWorker : public WorkerPool<ProcWorker, ProcJob>::Worker{
 public:
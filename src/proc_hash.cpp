@@ -54,20 +54,35 @@ int proc_multi_hsize(NetworkServer *net, const Request &req, Response *resp){
 	CHECK_NUM_PARAMS(2);
 	SSDBServer *serv = (SSDBServer *)net->data;
 
+	std::vector<int64_t> sizes;
+	int ret = serv->ssdb->multi_hsize(req, 1, &sizes);
 	resp->push_back("ok");
-	for(Request::const_iterator it=req.begin()+1; it!=req.end(); it++){
-		const Bytes &key = *it;
-		int64_t ret = serv->ssdb->hsize(key);
-		resp->push_back(key.String());
+	for(int i = 0; i < req.size() - 1; i++){
+		resp->push_back(req[1 + i].String());
 		if(ret == -1){
 			resp->push_back("-1");
 		}else{
-			resp->add(ret);
+			resp->add(sizes[i]);
 		}
 	}
 	return 0;
 }
 
+int proc_multi_hgetall(NetworkServer *net, const Request &req, Response *resp){
+	CHECK_NUM_PARAMS(2);
+	SSDBServer *serv = (SSDBServer *)net->data;
+
+	std::vector<std::string> list;
+	int ret;
+	if(resp->binary){
+		ret = serv->ssdb->multi_hgetall_packed(req, 1, &list);
+	}else{
+		ret = serv->ssdb->multi_hgetall(req, 1, &list);
+	}
+	resp->reply_list(ret, std::move(list));
+	return 0;
+}
+
 int proc_multi_hset(NetworkServer *net, const Request &req, Response *resp){
 	SSDBServer *serv = (SSDBServer *)net->data;
 	if(req.size() < 4 || req.size() % 2 != 0){
@@ -94,6 +109,17 @@ int proc_multi_hget(NetworkServer *net, const Request &req, Response *resp){
 	CHECK_NUM_PARAMS(3);
 	SSDBServer *serv = (SSDBServer *)net->data;
 
+	if(resp->binary){
+		std::string packed;
+		int ret = serv->ssdb->multi_hget_packed(req[1], req, 2, &packed);
+		if(ret == -1){
+			resp->push_back("error");
+			return 0;
+		}
+		resp->push_back("ok");
+		resp->push_back(std::move(packed));
+		return 0;
+	}
 	std::vector<std::string> vals;
 	int ret = serv->ssdb->multi_hget(req[1], req, 2, vals);
 	if(ret == -1){
@@ -132,6 +158,12 @@ int proc_hget(NetworkServer *net, const Request &req, Response *resp){
 	CHECK_NUM_PARAMS(3);
 	SSDBServer *serv = (SSDBServer *)net->data;
 
+	if(resp->binary){
+		std::string packed;
+		int ret = serv->ssdb->multi_hget_packed(req[1], req, 2, &packed);
+		resp->reply_get(ret == -1? -1 : (int)!packed.empty(), &packed);
+		return 0;
+	}
 	std::string val;
 	int ret = serv->ssdb->hget(req[1], req[2], &val);
 	resp->reply_get(ret, &val);
@@ -162,6 +194,17 @@ int proc_hgetall(NetworkServer *net, const Request &req, Response *resp){
 	CHECK_NUM_PARAMS(2);
 	SSDBServer *serv = (SSDBServer *)net->data;
 
+	if(resp->binary){
+		std::string packed;
+		int ret = serv->ssdb->hgetall_packed(req[1], &packed);
+		if(ret == -1){
+			resp->push_back("error");
+			return 0;
+		}
+		resp->push_back("ok");
+		resp->push_back(std::move(packed));
+		return 0;
+	}
 	std::vector<StrPair> values;
 	int ret = serv->ssdb->hgetall(req[1], values);
 	if(ret == -1){
@@ -179,13 +222,59 @@ int proc_hgetall(NetworkServer *net, const Request &req, Response *resp){
 	return 0;
 }
 
+int proc_hbest(NetworkServer *net, const Request &req, Response *resp){
+	CHECK_NUM_PARAMS(2);
+	SSDBServer *serv = (SSDBServer *)net->data;
+
+	int limit = 1;
+	if(req.size() > 2){
+		limit = req[2].Int();
+		if(errno != 0 || limit < 0){
+			resp->push_back("client_error");
+			resp->push_back("limit is not an integer or out of range");
+			return 0;
+		}
+	}
+	// negative: no margin filter
+	int margin = -1;
+	if(req.size() > 3){
+		margin = req[3].Int();
+		if(errno != 0){
+			resp->push_back("client_error");
+			resp->push_back("margin is not an integer");
+			return 0;
+		}
+	}
+	std::vector<StrPair> values;
+	int ret = serv->ssdb->hbest(req[1], limit, margin, values);
+	if(ret == -1){
+		resp->push_back("error");
+		return 0;
+	}
+	resp->push_back("ok");
+	for(auto &item : values){
+		resp->push_back(item.first);
+		resp->push_back(item.second);
+	}
+	return 0;
+}
+
 int proc_hscan(NetworkServer *net, const Request &req, Response *resp){
 	CHECK_NUM_PARAMS(5);
 	SSDBServer *serv = (SSDBServer *)net->data;
 
 	uint64_t limit = req[4].Uint64();
 	HIterator *it = serv->ssdb->hscan(req[1], req[2], req[3], limit);
-	if(it){
+	if(it && resp->binary){
+		std::string packed;
+		it->return_val(false);
+		while(it->next()){
+			packed.append(it->packed.data(), it->packed.size());
+		}
+		delete it;
+		resp->push_back("ok");
+		resp->push_back(std::move(packed));
+	}else if(it){
 		resp->push_back("ok");
 		while(it->next()){
 			resp->push_back(it->key);
@@ -204,7 +293,16 @@ int proc_hrscan(NetworkServer *net, const Request &req, Response *resp){
 
 	uint64_t limit = req[4].Uint64();
 	HIterator *it = serv->ssdb->hrscan(req[1], req[2], req[3], limit);
-	if(it){
+	if(it && resp->binary){
+		std::string packed;
+		it->return_val(false);
+		while(it->next()){
+			packed.append(it->packed.data(), it->packed.size());
+		}
+		delete it;
+		resp->push_back("ok");
+		resp->push_back(std::move(packed));
+	}else if(it){
 		resp->push_back("ok");
 		while(it->next()){
 			resp->push_back(it->key);
@@ -225,6 +323,7 @@ int proc_hkeys(NetworkServer *net, const Request &req, Response *resp){
 	HIterator *it = serv->ssdb->hscan(req[1], req[2], req[3], limit);
 	if(it){
 		resp->push_back("ok");
+		it->return_val(false);
 		while(it->next()){
 			resp->push_back(it->key);
 		}
@@ -16,6 +16,7 @@ DEF_PROC(hincr);
 DEF_PROC(hdecr);
 DEF_PROC(hclear);
 DEF_PROC(hgetall);
+DEF_PROC(hbest);
 DEF_PROC(hscan);
 DEF_PROC(hrscan);
 DEF_PROC(hkeys);
@@ -26,6 +27,7 @@ DEF_PROC(hexists);
 DEF_PROC(multi_hexists);
 DEF_PROC(multi_hsize);
 DEF_PROC(multi_hget);
+DEF_PROC(multi_hgetall);
 DEF_PROC(multi_hset);
 DEF_PROC(multi_hdel);
 DEF_PROC(migrate_hset);
@@ -53,7 +53,7 @@ int proc_info(NetworkServer *net, const Request &req, Response *resp){
 	resp->push_back(SSDB_VERSION);
 	{
 		int total = 0;
-		for (int i = 0; i < SERVE_THREADS; i++)
+		for (int i = 0; i < net->serve_threads; i++)
 			total += net->link_count[i];
 		resp->push_back("links");
 		resp->add(total);
@@ -73,6 +73,19 @@ int proc_info(NetworkServer *net, const Request &req, Response *resp){
 		resp->push_back(s);
 	}
 
+	if(req.size() > 1 && req[1] == "lanes"){
+		std::vector<std::string> lanes = net->lane_stats();
+		for(int i = 0; i + 1 < (int)lanes.size(); i += 2){
+			resp->push_back("lane." + lanes[i]);
+			resp->push_back(lanes[i + 1]);
+		}
+	}
+
+	if(req.size() > 1 && req[1] == "cache" && serv->ssdb->cache){
+		resp->push_back("cache");
+		resp->push_back(serv->ssdb->cache->stats());
+	}
+
 	if(req.size() > 1 && req[1] == "replication"){
 		{
 			std::vector<std::string> syncs = serv->backend_sync->stats();
@@ -134,7 +147,7 @@ int proc_redis_info(NetworkServer *net, const Request &req, Response *resp){
 	if(section.empty() || section == "server"){
 		s += "ssdb_version:" + std::string(SSDB_VERSION) + "\r\n";
 		int total = 0;
-		for(int i = 0; i < SERVE_THREADS; i++)
+		for(int i = 0; i < net->serve_threads; i++)
 			total += net->link_count[i];
 		s += "links:" + str(total) + "\r\n";
 	} else if(section == "calls"){
@@ -164,6 +177,43 @@ int proc_sync140(NetworkServer *net, Link *link, const Request &req, Response *r
 	return PROC_BACKEND;
 }
 
+// copy_range last_key end [frame], one of the parallel copy streams of a slave
+int proc_copy_range(NetworkServer *net, Link *link, const Request &req, Response *resp){
+	SSDBServer *serv = (SSDBServer *)net->data;
+	serv->backend_sync->proc(link);
+	return PROC_BACKEND;
+}
+
+int proc_checkpoint(NetworkServer *net, Link *link, const Request &req, Response *resp){
+	SSDBServer *serv = (SSDBServer *)net->data;
+	serv->backend_sync->checkpoint(link);
+	return PROC_BACKEND;
+}
+
+// sync_speed [sync|copy|total MB/s] | [weight ip n]
+int proc_sync_speed(NetworkServer *net, const Request &req, Response *resp){
+	SSDBServer *serv = (SSDBServer *)net->data;
+	if(req.size() == 3){
+		if(serv->backend_sync->set_speed(req[1].String(), req[2].Double()) == -1){
+			resp->push_back("client_error");
+			resp->push_back("unknown speed type");
+			return 0;
+		}
+	}else if(req.size() == 4 && req[1] == "weight"){
+		serv->backend_sync->set_weight(req[2].String(), req[3].Int());
+	}else if(req.size() != 1){
+		resp->push_back("client_error");
+		resp->push_back("wrong number of arguments");
+		return 0;
+	}
+	resp->push_back("ok");
+	std::vector<std::string> speeds = serv->backend_sync->speeds();
+	for(auto &s : speeds){
+		resp->push_back(s);
+	}
+	return 0;
+}
+
 int proc_clear_binlog(NetworkServer *net, const Request &req, Response *resp){
 	SSDBServer *serv = (SSDBServer *)net->data;
 	serv->ssdb->binlogs->flush();
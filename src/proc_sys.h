@@ -15,5 +15,8 @@ DEF_PROC(dbsize);
 DEF_PROC(compact);
 DEF_LINK_PROC(dump);
 DEF_LINK_PROC(sync140);
+DEF_LINK_PROC(copy_range);
+DEF_LINK_PROC(checkpoint);
+DEF_PROC(sync_speed);
 DEF_PROC(clear_binlog);
 DEF_PROC(flushdb);
@@ -6,6 +6,7 @@ found in the LICENSE file.
 #include "version.h"
 #include "util/log.h"
 #include "util/string_util.h"
+#include "util/file.h"
 #include "serv.h"
 #include "net/proc.h"
 #include "net/server.h"
@@ -16,6 +17,13 @@ found in the LICENSE file.
 #include "proc_queue.h"
 
 #define REG_PROC(c, f)     net->proc_map.set_proc(#c, f, (void*)proc_##c)
+#define REG_PROC_LANE(c, f, l) net->proc_map.set_proc(#c, f, (void*)proc_##c, Command::LANE_##l)
+
+// positions sharing a canonical name are stored, and locked, together
+static void canonical_lock_key(void *data, const Bytes &key, std::string *out){
+	SSDBServer *serv = (SSDBServer *)data;
+	serv->ssdb->hash_key(key, out);
+}
 
 void SSDBServer::reg_procs(NetworkServer *net){
 	REG_PROC(get, "r");
@@ -31,41 +39,61 @@ void SSDBServer::reg_procs(NetworkServer *net){
 	REG_PROC(getrange, "r");
 	REG_PROC(strlen, "r");
 	REG_PROC(bitcount, "r");
-	REG_PROC(incr, "wbs");
-	REG_PROC(decr, "wbs");
-	REG_PROC(scan, "rt");
-	REG_PROC(rscan, "rt");
-	REG_PROC(keys, "rt");
-	REG_PROC(rkeys, "rt");
+	if(ssdb->merge_counters){
+		REG_PROC(incr, "w");
+		REG_PROC(decr, "w");
+	}else{
+		REG_PROC(incr, "wbs");
+		REG_PROC(decr, "wbs");
+	}
+	REG_PROC_LANE(scan, "rt", SCAN);
+	REG_PROC_LANE(rscan, "rt", SCAN);
+	REG_PROC_LANE(keys, "rt", SCAN);
+	REG_PROC_LANE(rkeys, "rt", SCAN);
 	REG_PROC(exists, "r");
 	REG_PROC(multi_exists, "rs");
 	REG_PROC(multi_get, "rs");
-	REG_PROC(multi_set, "w");
-	REG_PROC(multi_del, "w");
+	REG_PROC(multi_set, "w2");
+	REG_PROC(multi_del, "w1");
 	REG_PROC(ttl, "r");
 	REG_PROC(expire, "w");
 
 	REG_PROC(hsize, "r");
 	REG_PROC(hget, "r");
 	REG_PROC(hset, "w");
-	REG_PROC(hdel, "wbs");
-	REG_PROC(hincr, "wbs");
-	REG_PROC(hdecr, "wbs");
+	if(ssdb->blind_delete){
+		REG_PROC(hdel, "w");
+	}else{
+		REG_PROC(hdel, "wbs");
+	}
+	if(ssdb->merge_counters){
+		REG_PROC(hincr, "w");
+		REG_PROC(hdecr, "w");
+	}else{
+		REG_PROC(hincr, "wbs");
+		REG_PROC(hdecr, "wbs");
+	}
 	REG_PROC(hclear, "w");
 	REG_PROC(hgetall, "r");
+	REG_PROC(hbest, "r");
 	REG_PROC(hscan, "r");
 	REG_PROC(hrscan, "r");
 	REG_PROC(hkeys, "r");
 	REG_PROC(hvals, "r");
-	REG_PROC(hlist, "rt");
-	REG_PROC(hrlist, "rt");
+	REG_PROC_LANE(hlist, "rt", SCAN);
+	REG_PROC_LANE(hrlist, "rt", SCAN);
 	REG_PROC(hexists, "r");
 	REG_PROC(multi_hexists, "rs");
 	REG_PROC(multi_hsize, "rs");
 	REG_PROC(multi_hget, "rs");
+	REG_PROC(multi_hgetall, "rs");
 	REG_PROC(multi_hset, "w");
-	REG_PROC(multi_hdel, "wbs");
-	REG_PROC(migrate_hset, "w");
+	if(ssdb->blind_delete){
+		REG_PROC(multi_hdel, "w");
+	}else{
+		REG_PROC(multi_hdel, "wbs");
+	}
+	REG_PROC(migrate_hset, "w3");
 
 	REG_PROC(zrank, "rs");
 	REG_PROC(zrrank, "rs");
@@ -84,8 +112,8 @@ void SSDBServer::reg_procs(NetworkServer *net){
 	REG_PROC(zscan, "rs");
 	REG_PROC(zrscan, "rs");
 	REG_PROC(zkeys, "rs");
-	REG_PROC(zlist, "rt");
-	REG_PROC(zrlist, "rt");
+	REG_PROC_LANE(zlist, "rt", SCAN);
+	REG_PROC_LANE(zrlist, "rt", SCAN);
 	REG_PROC(zcount, "rs");
 	REG_PROC(zsum, "rs");
 	REG_PROC(zavg, "rs");
@@ -113,23 +141,26 @@ void SSDBServer::reg_procs(NetworkServer *net){
 	REG_PROC(qtrim_back, "wbs");
 	REG_PROC(qfix, "wbs");
 	REG_PROC(qclear, "wbs");
-	REG_PROC(qlist, "rt");
-	REG_PROC(qrlist, "rt");
+	REG_PROC_LANE(qlist, "rt", SCAN);
+	REG_PROC_LANE(qrlist, "rt", SCAN);
 	REG_PROC(qslice, "rs");
 	REG_PROC(qrange, "rs");
 	REG_PROC(qget, "r");
 	REG_PROC(qset, "wbs");
 
-	REG_PROC(clear_binlog, "wbt");
-	REG_PROC(flushdb, "wbt");
+	REG_PROC_LANE(clear_binlog, "wgt", ADMIN);
+	REG_PROC_LANE(flushdb, "wgt", ADMIN);
 
 	REG_PROC(dump, "p");
 	REG_PROC(sync140, "p");
+	REG_PROC(copy_range, "p");
+	REG_PROC(checkpoint, "p");
 	REG_PROC(info, "r");
 	REG_PROC(redis_info, "r");
 	REG_PROC(version, "r");
 	REG_PROC(dbsize, "r");
-	REG_PROC(compact, "rt");
+	REG_PROC_LANE(compact, "rt", ADMIN);
+	REG_PROC_LANE(sync_speed, "rt", ADMIN);
 }
 
 
@@ -139,11 +170,21 @@ SSDBServer::SSDBServer(SSDB *ssdb, SSDB *meta, const Config &conf, NetworkServer
 
 	net->data = this;
 	this->reg_procs(net);
+	if(this->ssdb->canonical_names()){
+		net->key_locks.set_canonical(canonical_lock_key, this);
+	}
 
 	int sync_speed = conf.get_num("replication.sync_speed");
+	int sync_window = conf.get_num("replication.sync_window");
+	// copies used to share sync_speed
+	int copy_speed = sync_speed;
+	if(conf.get("replication.copy_speed") != NULL){
+		copy_speed = conf.get_num("replication.copy_speed");
+	}
+	int total_speed = conf.get_num("replication.total_speed");
 
 	backend_dump = new BackendDump(this->ssdb);
-	backend_sync = new BackendSync(this->ssdb, sync_speed);
+	backend_sync = new BackendSync(this->ssdb, sync_speed, sync_window, copy_speed, total_speed);
 	expiration = new ExpirationHandler(this->ssdb);
 	
 	{ // slaves
@@ -175,9 +216,14 @@ SSDBServer::SSDBServer(SSDB *ssdb, SSDB *meta, const Config &conf, NetworkServer
 				std::string id = c->get_str("id");
 				std::string auth = c->get_str("auth");
 				int recv_timeout = c->get_num("recv_timeout");
+				std::string frame = c->get_str("frame");
+				if(frame != "lz4" && frame != "raw"){
+					frame = "";
+				}
+				int copy_streams = c->get_num("copy_streams");
 				
 				log_info("slaveof: %s:%d, type: %s", ip.c_str(), port, type.c_str());
-				this->slaveof(id, ip, port, auth, 0, "", is_mirror, recv_timeout);
+				this->slaveof(id, ip, port, auth, 0, "", is_mirror, recv_timeout, frame, copy_streams);
 			}
 		}
 	}
@@ -198,7 +244,43 @@ SSDBServer::~SSDBServer(){
 	log_debug("SSDBServer finalized");
 }
 
-int SSDBServer::slaveof(const std::string &id, const std::string &host, int port, const std::string &auth, uint64_t last_seq, const std::string &last_key, bool is_mirror, int recv_timeout){
+int SSDBServer::bootstrap(const Config &conf, SSDB *meta, const std::string &dir){
+	if(file_exists(dir)){
+		return 0;
+	}
+	const Config *repl_conf = conf.get("replication");
+	if(repl_conf == NULL){
+		return 0;
+	}
+	std::vector<Config *> children = repl_conf->children;
+	for(std::vector<Config *>::iterator it = children.begin(); it != children.end(); it++){
+		Config *c = *it;
+		std::string type = c->get_str("bootstrap");
+		if(c->key != "slaveof" || type != "checkpoint"){
+			continue;
+		}
+		std::string ip = c->get_str("ip");
+		int port = c->get_num("port");
+		if(ip == ""){
+			ip = c->get_str("host");
+		}
+		if(ip == "" || port <= 0 || port > 65535){
+			continue;
+		}
+		std::string id = c->get_str("id");
+		if(id.empty()){
+			// the same as Slave's default id
+			char buf[128];
+			snprintf(buf, sizeof(buf), "%s|%d", ip.c_str(), port);
+			id = buf;
+		}
+		// on error the slave copies the master as usual
+		return Slave::bootstrap(meta, id, ip, port, c->get_str("auth"), dir);
+	}
+	return 0;
+}
+
+int SSDBServer::slaveof(const std::string &id, const std::string &host, int port, const std::string &auth, uint64_t last_seq, const std::string &last_key, bool is_mirror, int recv_timeout, const std::string &frame, int copy_streams){
 	Slave *slave = new Slave(ssdb, meta, host.c_str(), port, is_mirror);
 	if(!id.empty()){
 		slave->set_id(id);
@@ -209,6 +291,10 @@ int SSDBServer::slaveof(const std::string &id, const std::string &host, int port
 	slave->last_seq = last_seq;
 	slave->last_key = last_key;
 	slave->auth = auth;
+	slave->frame = frame;
+	if(copy_streams > 1){
+		slave->copy_streams = copy_streams;
+	}
 	slave->start();
 	slaves.push_back(slave);
 	return 0;
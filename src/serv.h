@@ -32,7 +32,12 @@ public:
 	SSDBServer(SSDB *ssdb, SSDB *meta, const Config &conf, NetworkServer *net);
 	~SSDBServer();
 	
-	int slaveof(const std::string &id, const std::string &host, int port, const std::string &auth, uint64_t last_seq, const std::string &last_key, bool is_mirror, int recv_timeout);
+	// before the data db at dir is opened, fills it with a checkpoint of
+	// the first master configured with "bootstrap: checkpoint" if it
+	// doesn't exist yet
+	static int bootstrap(const Config &conf, SSDB *meta, const std::string &dir);
+
+	int slaveof(const std::string &id, const std::string &host, int port, const std::string &auth, uint64_t last_seq, const std::string &last_key, bool is_mirror, int recv_timeout, const std::string &frame, int copy_streams);
 };
 
 #define CHECK_NUM_PARAMS(n) do{ \
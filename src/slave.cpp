@@ -3,11 +3,17 @@ Copyright (c) 2012-2014 The SSDB Authors. All rights reserved.
 Use of this source code is governed by a BSD-style license that can be
 found in the LICENSE file.
 */
+#include <stdio.h>
+#include <sys/stat.h>
+#include <algorithm>
 #include "net/fde.h"
 #include "util/log.h"
+#include "util/file.h"
 #include "slave.h"
 #include "include.h"
 
+#define RECV_TIMEOUT		200
+
 Slave::Slave(SSDB *ssdb, SSDB *meta, const char *ip, int port, bool is_mirror){
 	thread_quit = false;
 	this->recv_timeout = 30;
@@ -36,6 +42,10 @@ Slave::Slave(SSDB *ssdb, SSDB *meta, const char *ip, int port, bool is_mirror){
 	
 	this->copy_count = 0;
 	this->sync_count = 0;
+	this->copy_streams = 1;
+	this->batching = false;
+	this->batch_count = 0;
+	this->replay_max_seq = 0;
 }
 
 Slave::~Slave(){
@@ -110,8 +120,12 @@ void Slave::set_id(const std::string &id){
 }
 
 std::string Slave::status_key(){
+	return status_key(this->id_);
+}
+
+std::string Slave::status_key(const std::string &id){
 	std::string key;
-	key = "slave.status." + this->id_;
+	key = "slave.status." + id;
 	return key;
 }
 
@@ -161,7 +175,11 @@ int Slave::connect(){
 				}
 			}
 			
-			link->send("sync140", str(this->last_seq), this->last_key, type);
+			if(this->frame.empty()){
+				link->send("sync140", str(this->last_seq), this->last_key, type);
+			}else{
+				link->send("sync140", str(this->last_seq), this->last_key, type, this->frame);
+			}
 			if(link->flush() == -1){
 				log_error("[%s] network error", this->id_.c_str());
 				delete link;
@@ -185,8 +203,9 @@ void* Slave::_run_thread(void *arg){
 	int idle = 0;
 	bool reconnect = false;
 	
-#define RECV_TIMEOUT		200
 	int max_idle = (slave->recv_timeout * 1000) / RECV_TIMEOUT;
+	// slaveof runs on a worker, which may be pinned
+	unpin_thread();
 
 	while(!slave->thread_quit){
 		if(reconnect){
@@ -197,6 +216,12 @@ void* Slave::_run_thread(void *arg){
 			slave->link = NULL;
 			sleep(1);
 		}
+		if(!slave->connected() && slave->copy_streams > 1){
+			if(slave->copy_ranges() == -1){
+				sleep(1);
+				continue;
+			}
+		}
 		if(!slave->connected()){
 			if(slave->connect() != 1){
 				usleep(100 * 1000);
@@ -227,6 +252,7 @@ void* Slave::_run_thread(void *arg){
 			continue;
 		}
 
+		slave->batching = true;
 		while(1){
 			req = slave->link->recv();
 			if(req == NULL){
@@ -246,6 +272,11 @@ void* Slave::_run_thread(void *arg){
 				}
 			}
 		}
+		slave->batching = false;
+		// last_seq already covers the batch, it must not be saved unwritten
+		if(slave->end_batch() == -1){
+			goto err;
+		}
 	} // end while
 	log_info("Slave thread quit");
 	return (void *)NULL;
@@ -268,6 +299,9 @@ int Slave::proc(const std::vector<Bytes> &req){
 			return this->proc_noop(log, req);
 			break;
 		case BinlogType::CTRL:
+			if(log.cmd() == BinlogCommand::FRAME){
+				return this->proc_frame(log, req);
+			}
 			if(log.key() == "OUT_OF_SYNC"){
 				status = OUT_OF_SYNC;
 				log_error("OUT_OF_SYNC, you must reset this node manually!");
@@ -304,7 +338,32 @@ int Slave::proc(const std::vector<Bytes> &req){
 	return 0;
 }
 
+int Slave::proc_frame(const Binlog &log, const std::vector<Bytes> &req){
+	if(req.size() != 2){
+		log_error("invalid frame!");
+		return 0;
+	}
+	std::string raw;
+	std::vector<std::vector<Bytes> > reqs;
+	if(BinlogFrame::decode(log.key(), req[1], &raw, &reqs) == -1){
+		log_error("invalid %s frame!", log.key().String().c_str());
+		return 0;
+	}
+	for(int i = 0; i < (int)reqs.size(); i++){
+		if(reqs[i].empty()){
+			continue;
+		}
+		if(this->proc(reqs[i]) == -1){
+			return -1;
+		}
+	}
+	return 0;
+}
+
 int Slave::proc_noop(const Binlog &log, const std::vector<Bytes> &req){
+	if(this->end_batch() == -1){
+		return -1;
+	}
 	uint64_t seq = log.seq();
 	if(this->last_seq != seq){
 		log_debug("noop last_seq: %" PRIu64 ", seq: %" PRIu64 "", this->last_seq, seq);
@@ -318,6 +377,7 @@ int Slave::proc_copy(const Binlog &log, const std::vector<Bytes> &req){
 	switch(log.cmd()){
 		case BinlogCommand::BEGIN:
 			log_info("copy begin");
+			this->clear_replay();
 			// log_info("start flushdb...");
 			// this->last_seq = 0;
 			// this->last_key = "";
@@ -326,6 +386,9 @@ int Slave::proc_copy(const Binlog &log, const std::vector<Bytes> &req){
 			// log_info("end flushdb.");
 			break;
 		case BinlogCommand::END:
+			if(this->end_batch() == -1){
+				return -1;
+			}
 			log_info("copy end, copy_count: %" PRIu64 ", last_seq: %" PRIu64 ", seq: %" PRIu64,
 				copy_count, this->last_seq, log.seq());
 			this->status = SYNC;
@@ -343,7 +406,57 @@ int Slave::proc_copy(const Binlog &log, const std::vector<Bytes> &req){
 	return 0;
 }
 
+// Blind writes received in one read are applied in one transaction, and
+// the position is saved once it is written. Others read the db, so the
+// batch is written before them.
 int Slave::proc_sync(const Binlog &log, const std::vector<Bytes> &req){
+	char cmd = log.cmd();
+	bool blind = cmd == BinlogCommand::KSET || cmd == BinlogCommand::KDEL
+		|| cmd == BinlogCommand::HSET || cmd == BinlogCommand::HDEL
+		|| cmd == BinlogCommand::HMERGE;
+	if(this->batching && blind){
+		if(this->batch_count == 0){
+			((SSDBImpl *)ssdb)->binlogs->begin();
+		}
+		this->batch_count ++;
+	}else if(this->end_batch() == -1){
+		return -1;
+	}
+	if(log.type() != BinlogType::COPY && this->replayed(log)){
+		log_debug("skip replayed %s", log.dumps().c_str());
+	}else if(this->apply(log, req) == -1){
+		return -1;
+	}
+	this->last_seq = log.seq();
+	if(log.type() == BinlogType::COPY){
+		this->last_key = log.key().String();
+	}
+	if(this->batch_count >= MAX_BATCH_COUNT){
+		return this->end_batch();
+	}
+	if(this->batch_count == 0){
+		this->save_status();
+	}
+	return 0;
+}
+
+int Slave::end_batch(){
+	if(this->batch_count == 0){
+		return 0;
+	}
+	BinlogQueue *binlogs = ((SSDBImpl *)ssdb)->binlogs;
+	TERARKDB_NAMESPACE::Status s = binlogs->commit();
+	binlogs->release();
+	this->batch_count = 0;
+	if(!s.ok()){
+		log_error("apply batch error: %s", s.ToString().c_str());
+		return -1;
+	}
+	this->save_status();
+	return 0;
+}
+
+int Slave::apply(const Binlog &log, const std::vector<Bytes> &req){
 	switch(log.cmd()){
 		case BinlogCommand::KSET:
 			{
@@ -389,6 +502,13 @@ int Slave::proc_sync(const Binlog &log, const std::vector<Bytes> &req){
 				}
 			}
 			break;
+		case BinlogCommand::HMERGE:
+			{
+				if(ssdb->sync_hmerge(log.key(), log.val(), log_type) == -1){
+					return -1;
+				}
+			}
+			break;
 		case BinlogCommand::ZSET:
 			{
 				if(req.size() != 2){
@@ -473,11 +593,492 @@ int Slave::proc_sync(const Binlog &log, const std::vector<Bytes> &req){
 			log_error("unknown binlog, type=%d, cmd=%d", log.type(), log.cmd());
 			break;
 	}
-	this->last_seq = log.seq();
-	if(log.type() == BinlogType::COPY){
-		this->last_key = log.key().String();
+	return 0;
+}
+
+/* parallel copy */
+
+struct Slave::CopyRange{
+	Slave *slave;
+	int index;
+	// copies (last_key, end], end is empty for the last range
+	std::string last_key;
+	std::string end;
+	// the smallest seq of the iterators the master copied this range with
+	uint64_t seq;
+	bool done;
+	uint64_t count;
+	pthread_t tid;
+};
+
+std::string Slave::range_key(int index){
+	return range_key(this->id_, index);
+}
+
+std::string Slave::range_key(const std::string &id, int index){
+	return status_key(id) + ".range." + str(index);
+}
+
+int Slave::load_ranges(std::vector<CopyRange> *ranges){
+	std::string val;
+	meta->get(status_key() + ".ranges", &val);
+	int n = val.empty()? 0 : str_to_int(val);
+	ranges->resize(n);
+	for(int i = 0; i < n; i++){
+		CopyRange &r = (*ranges)[i];
+		std::string seq, done;
+		meta->get(range_key(i) + ".last_key", &r.last_key);
+		meta->get(range_key(i) + ".end", &r.end);
+		meta->get(range_key(i) + ".seq", &seq);
+		meta->get(range_key(i) + ".done", &done);
+		r.index = i;
+		r.seq = seq.empty()? 0 : str_to_uint64(seq);
+		r.done = (done == "1");
+		r.count = 0;
+	}
+	return n;
+}
+
+void Slave::save_range(const CopyRange &range){
+	meta->set(range_key(range.index) + ".last_key", range.last_key);
+	meta->set(range_key(range.index) + ".end", range.end);
+	meta->set(range_key(range.index) + ".seq", str(range.seq));
+	meta->set(range_key(range.index) + ".done", range.done? "1" : "0");
+}
+
+void Slave::clear_ranges(){
+	clear_ranges(this->meta, this->id_);
+}
+
+void Slave::clear_ranges(SSDB *meta, const std::string &id){
+	std::string val;
+	meta->get(status_key(id) + ".ranges", &val);
+	int n = val.empty()? 0 : str_to_int(val);
+	for(int i = 0; i < n; i++){
+		meta->del(range_key(id, i) + ".last_key");
+		meta->del(range_key(id, i) + ".end");
+		meta->del(range_key(id, i) + ".seq");
+		meta->del(range_key(id, i) + ".done");
+	}
+	meta->del(status_key(id) + ".ranges");
+}
+
+Link* Slave::open_link(){
+	Link *link = Link::connect(master_ip.c_str(), master_port);
+	if(link == NULL){
+		log_error("[%s] failed to connect to master: %s:%d! %s",
+			this->id_.c_str(), master_ip.c_str(), master_port, strerror(errno));
+		return NULL;
+	}
+	if(!this->auth.empty()){
+		const std::vector<Bytes> *resp = link->request("auth", this->auth);
+		if(resp == NULL || resp->empty() || (*resp)[0] != "ok"){
+			log_error("[%s] auth error", this->id_.c_str());
+			delete link;
+			return NULL;
+		}
+	}
+	return link;
+}
+
+// splits the keyspace by the bottom level sst boundaries of the master
+int Slave::fetch_ranges(std::vector<CopyRange> *ranges){
+	Link *link = this->open_link();
+	if(link == NULL){
+		return -1;
+	}
+	const std::vector<Bytes> *resp = link->request("info", "range");
+	if(resp == NULL || resp->empty() || (*resp)[0] != "ok"){
+		log_error("[%s] info range error", this->id_.c_str());
+		delete link;
+		return -1;
+	}
+	std::vector<std::string> keys;
+	int i = 2;
+	while(i < (int)resp->size() && (*resp)[i] != "range"){
+		i += 2;
+	}
+	for(i++; i < (int)resp->size(); i++){
+		const Bytes &key = (*resp)[i];
+		// pushes of a queue must stay in one stream to keep their order
+		if(key.empty() || key.data()[0] == DataType::QUEUE){
+			continue;
+		}
+		if(keys.empty() || key.compare(keys.back()) > 0){
+			keys.push_back(key.String());
+		}
+	}
+	delete link;
+
+	std::vector<std::string> bounds;
+	for(int i = 1; i < copy_streams && !keys.empty(); i++){
+		const std::string &key = keys[(uint64_t)keys.size() * i / copy_streams];
+		if(bounds.empty() || key > bounds.back()){
+			bounds.push_back(key);
+		}
+	}
+	ranges->resize(bounds.size() + 1);
+	for(int i = 0; i < (int)ranges->size(); i++){
+		CopyRange &r = (*ranges)[i];
+		r.index = i;
+		r.last_key = (i == 0)? "" : bounds[i - 1];
+		r.end = (i == (int)bounds.size())? "" : bounds[i];
+		r.seq = 0;
+		r.done = false;
+		r.count = 0;
+	}
+	return 0;
+}
+
+// Copies the master over copy_streams connections on disjoint key ranges
+// before a fresh slave syncs binlogs. Each range resumes from its own
+// last_key. Writes that land during the copy are replayed by the binlog
+// sync, which starts after the smallest seq any range was copied at, and
+// skips the logs of a range that it was copied after.
+int Slave::copy_ranges(){
+	std::vector<CopyRange> ranges;
+	if(this->load_ranges(&ranges) == 0){
+		if(this->last_seq != 0 || !this->last_key.empty()){
+			return 0;
+		}
+		if(this->fetch_ranges(&ranges) == -1){
+			return -1;
+		}
+		for(auto &r : ranges){
+			this->save_range(r);
+		}
+		meta->set(status_key() + ".ranges", str((int)ranges.size()));
+		log_info("[%s] copy begin, %d ranges", this->id_.c_str(), (int)ranges.size());
+	}
+
+	for(auto &r : ranges){
+		r.slave = this;
+		r.tid = 0;
+		if(r.done){
+			continue;
+		}
+		this->status = COPY;
+		int err = pthread_create(&r.tid, NULL, &Slave::_copy_thread, &r);
+		if(err != 0){
+			log_error("can't create thread: %s", strerror(err));
+			r.tid = 0;
+		}
+	}
+	bool copied = false;
+	for(auto &r : ranges){
+		if(r.tid){
+			pthread_join(r.tid, NULL);
+			copied = true;
+		}
+	}
+
+	uint64_t seq = 0;
+	uint64_t count = 0;
+	for(auto &r : ranges){
+		if(!r.done){
+			return -1;
+		}
+		if(seq == 0 || r.seq < seq){
+			seq = r.seq;
+		}
+		count += r.count;
+	}
+	if(seq == 0){
+		// the master has no binlogs to sync from, copy again in one stream
+		log_info("[%s] copy end without binlogs, copy again", this->id_.c_str());
+		this->clear_ranges();
+		this->copy_streams = 1;
+		return 1;
+	}
+	if(copied){
+		log_info("[%s] copy end, copy_count: %" PRIu64 ", seq: %" PRIu64 "", this->id_.c_str(), count, seq);
+		this->copy_count += count;
+	}
+	// the ranges of a finished copy are loaded again on every reconnect,
+	// and the sync may already be past them
+	if(this->last_seq < seq){
+		this->last_seq = seq;
+		this->last_key = "";
+		this->save_status();
+	}
+	this->load_replay(ranges);
+	return 1;
+}
+
+void Slave::load_replay(const std::vector<CopyRange> &ranges){
+	replay_ends.clear();
+	replay_seqs.clear();
+	replay_max_seq = 0;
+	for(auto &r : ranges){
+		replay_ends.push_back(r.end);
+		replay_seqs.push_back(r.seq);
+		replay_max_seq = std::max(replay_max_seq, r.seq);
+	}
+	if(this->last_seq >= replay_max_seq){
+		this->clear_replay();
+	}
+}
+
+void Slave::clear_replay(){
+	if(!replay_seqs.empty()){
+		this->clear_ranges();
+	}
+	replay_ends.clear();
+	replay_seqs.clear();
+	replay_max_seq = 0;
+}
+
+// whether the range the key of log is in was copied after log
+bool Slave::replayed(const Binlog &log){
+	if(replay_seqs.empty()){
+		return false;
+	}
+	if(log.seq() > replay_max_seq){
+		log_info("[%s] sync passed the copied ranges, seq: %" PRIu64 "",
+			this->id_.c_str(), log.seq());
+		this->clear_replay();
+		return false;
+	}
+	std::string key;
+	if(log.cmd() == BinlogCommand::QPOP_BACK || log.cmd() == BinlogCommand::QPOP_FRONT){
+		// the key of a pop is the name, the items of a queue are in one range
+		key = encode_qitem_key(log.key(), QFRONT_SEQ);
+	}else{
+		key = log.key().String();
+	}
+	int i = std::lower_bound(replay_ends.begin(), replay_ends.end() - 1, key) - replay_ends.begin();
+	return log.seq() <= replay_seqs[i];
+}
+
+void* Slave::_copy_thread(void *arg){
+	CopyRange *range = (CopyRange *)arg;
+	Slave *slave = range->slave;
+	int max_idle = (slave->recv_timeout * 1000) / RECV_TIMEOUT;
+
+	while(!slave->thread_quit && !range->done){
+		Link *link = slave->open_link();
+		if(link == NULL){
+			sleep(1);
+			continue;
+		}
+		link->send("copy_range", range->last_key, range->end, slave->frame);
+		if(link->flush() == -1){
+			delete link;
+			sleep(1);
+			continue;
+		}
+
+		Fdevents select;
+		select.set(link->fd(), FDEVENT_IN, 0, NULL);
+		int idle = 0;
+		while(!slave->thread_quit && !range->done){
+			const Fdevents::events_t *events = select.wait(RECV_TIMEOUT);
+			if(events == NULL){
+				break;
+			}else if(events->empty()){
+				if(idle++ >= max_idle){
+					log_error("[%s] range %d, the master hasn't responsed for awhile, reconnect...",
+						slave->id_.c_str(), range->index);
+					break;
+				}
+				continue;
+			}
+			idle = 0;
+			if(link->read() <= 0){
+				break;
+			}
+			const std::vector<Bytes> *req;
+			int ret = 0;
+			while((req = link->recv()) != NULL && !req->empty()){
+				ret = slave->proc_range(range, *req);
+				if(ret == -1){
+					break;
+				}
+			}
+			if(req == NULL || ret == -1){
+				break;
+			}
+		}
+		select.del(link->fd());
+		delete link;
+		slave->save_range(*range);
+		if(!range->done && !slave->thread_quit){
+			sleep(1);
+		}
+	}
+	return (void *)NULL;
+}
+
+int Slave::proc_range(CopyRange *range, const std::vector<Bytes> &req){
+	Binlog log;
+	if(log.load(req[0]) == -1){
+		log_error("invalid binlog!");
+		return 0;
+	}
+	if(log.type() == BinlogType::CTRL && log.cmd() == BinlogCommand::FRAME){
+		std::string raw;
+		std::vector<std::vector<Bytes> > reqs;
+		if(req.size() != 2 || BinlogFrame::decode(log.key(), req[1], &raw, &reqs) == -1){
+			log_error("invalid frame!");
+			return -1;
+		}
+		for(int i = 0; i < (int)reqs.size(); i++){
+			if(!reqs[i].empty() && this->proc_range(range, reqs[i]) == -1){
+				return -1;
+			}
+		}
+		return 0;
+	}
+	if(log.type() != BinlogType::COPY){
+		return 0;
+	}
+	switch(log.cmd()){
+		case BinlogCommand::BEGIN:
+			if(range->seq == 0 || log.seq() < range->seq){
+				range->seq = log.seq();
+				this->save_range(*range);
+			}
+			break;
+		case BinlogCommand::END:
+			log_info("[%s] range %d copied, copy_count: %" PRIu64 "",
+				this->id_.c_str(), range->index, range->count);
+			range->done = true;
+			this->save_range(*range);
+			break;
+		default:
+			if(this->apply(log, req) == -1){
+				return -1;
+			}
+			range->last_key = log.key().String();
+			if(++range->count % 1000 == 0){
+				this->save_range(*range);
+			}
+			break;
 	}
-	this->save_status();
 	return 0;
 }
 
+
+/* bootstrap */
+
+int Slave::bootstrap(SSDB *meta, const std::string &id, const std::string &host, int port, const std::string &auth, const std::string &dir){
+	std::string tmp_dir = dir + ".bootstrap";
+	if(is_dir(tmp_dir)){
+		remove_dir(tmp_dir);
+	}
+	if(mkdir(tmp_dir.c_str(), 0755) == -1){
+		log_error("[%s] mkdir %s error: %s", id.c_str(), tmp_dir.c_str(), strerror(errno));
+		return -1;
+	}
+	log_info("[%s] bootstrap from checkpoint of %s:%d", id.c_str(), host.c_str(), port);
+
+	Link *link = Link::connect(host.c_str(), port);
+	if(link == NULL){
+		log_error("[%s] failed to connect to master: %s:%d! %s", id.c_str(), host.c_str(), port, strerror(errno));
+		remove_dir(tmp_dir);
+		return -1;
+	}
+	if(!auth.empty()){
+		const std::vector<Bytes> *resp = link->request("auth", auth);
+		if(resp == NULL || resp->empty() || (*resp)[0] != "ok"){
+			log_error("[%s] auth error", id.c_str());
+			delete link;
+			remove_dir(tmp_dir);
+			return -1;
+		}
+	}
+
+	int ret = -1;
+	uint64_t seq = 0;
+	uint64_t bytes = 0;
+	std::string file;
+	uint64_t file_size = 0;
+	FILE *fp = NULL;
+	Fdevents select;
+	int idle = 0;
+	int max_idle = (30 * 1000) / RECV_TIMEOUT;
+
+	link->send("checkpoint");
+	if(link->flush() == -1){
+		goto end;
+	}
+	select.set(link->fd(), FDEVENT_IN, 0, NULL);
+	while(ret == -1){
+		const Fdevents::events_t *events = select.wait(RECV_TIMEOUT);
+		if(events == NULL){
+			goto end;
+		}else if(events->empty()){
+			if(idle++ >= max_idle){
+				log_error("[%s] the master hasn't responsed for awhile", id.c_str());
+				goto end;
+			}
+			continue;
+		}
+		idle = 0;
+		if(link->read() <= 0){
+			log_error("[%s] link.read error: %s", id.c_str(), strerror(errno));
+			goto end;
+		}
+		const std::vector<Bytes> *req;
+		while(ret == -1 && (req = link->recv()) != NULL && !req->empty()){
+			if((*req)[0] == "file" && req->size() == 4){
+				std::string name = (*req)[1].String();
+				if(name.empty() || name.find('/') != std::string::npos){
+					log_error("[%s] bad file name: %s", id.c_str(), name.c_str());
+					goto end;
+				}
+				if(name != file){
+					if(fp){
+						fclose(fp);
+					}
+					file = name;
+					file_size = 0;
+					fp = fopen((tmp_dir + "/" + file).c_str(), "wb");
+					if(!fp){
+						log_error("[%s] open %s error: %s", id.c_str(), file.c_str(), strerror(errno));
+						goto end;
+					}
+				}
+				const Bytes &data = (*req)[3];
+				if((*req)[2].Uint64() != file_size || fwrite(data.data(), 1, data.size(), fp) != (size_t)data.size()){
+					log_error("[%s] write %s error", id.c_str(), file.c_str());
+					goto end;
+				}
+				file_size += data.size();
+				bytes += data.size();
+			}else if((*req)[0] == "end" && req->size() == 2){
+				seq = (*req)[1].Uint64();
+				ret = 0;
+			}else{
+				log_error("[%s] bootstrap error: %s", id.c_str(), (*req)[req->size() - 1].String().c_str());
+				goto end;
+			}
+		}
+		if(req == NULL){
+			log_error("[%s] link.recv error: %s", id.c_str(), strerror(errno));
+			goto end;
+		}
+	}
+
+end:
+	if(fp){
+		if(fclose(fp) != 0){
+			ret = -1;
+		}
+	}
+	delete link;
+	if(ret == 0 && rename(tmp_dir.c_str(), dir.c_str()) == -1){
+		log_error("[%s] rename %s error: %s", id.c_str(), tmp_dir.c_str(), strerror(errno));
+		ret = -1;
+	}
+	if(ret == -1){
+		remove_dir(tmp_dir);
+		return -1;
+	}
+	// a parallel copy left over would copy again over the checkpoint
+	clear_ranges(meta, id);
+	meta->set(status_key(id) + ".last_key", "");
+	meta->set(status_key(id) + ".last_seq", str(seq));
+	log_info("[%s] bootstrap done, %" PRIu64 " bytes, seq: %" PRIu64 "", id.c_str(), bytes, seq);
+	return 0;
+}
@@ -37,6 +37,7 @@ private:
 	int status;
 
 	std::string status_key();
+	static std::string status_key(const std::string &id);
 	void load_status();
 	void save_status();
 
@@ -45,9 +46,38 @@ private:
 	static void* _run_thread(void *arg);
 		
 	int proc(const std::vector<Bytes> &req);
+	int proc_frame(const Binlog &log, const std::vector<Bytes> &req);
 	int proc_noop(const Binlog &log, const std::vector<Bytes> &req);
 	int proc_copy(const Binlog &log, const std::vector<Bytes> &req);
 	int proc_sync(const Binlog &log, const std::vector<Bytes> &req);
+	int apply(const Binlog &log, const std::vector<Bytes> &req);
+
+	// records of one read from the master are applied in one batch
+	static const int MAX_BATCH_COUNT = 10000;
+	bool batching;
+	int batch_count;
+	int end_batch();
+
+	struct CopyRange;
+	std::string range_key(int index);
+	static std::string range_key(const std::string &id, int index);
+	int load_ranges(std::vector<CopyRange> *ranges);
+	void save_range(const CopyRange &range);
+	void clear_ranges();
+	static void clear_ranges(SSDB *meta, const std::string &id);
+	Link* open_link();
+	int fetch_ranges(std::vector<CopyRange> *ranges);
+	int copy_ranges();
+	static void* _copy_thread(void *arg);
+	int proc_range(CopyRange *range, const std::vector<Bytes> &req);
+	// ends and seqs of the copied ranges, kept until the sync passes the
+	// largest seq, logs a range was copied after are not applied again
+	std::vector<std::string> replay_ends;
+	std::vector<uint64_t> replay_seqs;
+	uint64_t replay_max_seq;
+	void load_replay(const std::vector<CopyRange> &ranges);
+	void clear_replay();
+	bool replayed(const Binlog &log);
 
 	unsigned int connect_retry;
 	int connect();
@@ -62,12 +92,20 @@ public:
 	uint64_t last_seq;
 	std::string last_key;
 	std::string auth;
+	// ask the master to send binlogs in frames, "lz4" or "raw", empty for
+	// one message per binlog
+	std::string frame;
+	// parallel copy streams of a fresh slave
+	int copy_streams;
 	Slave(SSDB *ssdb, SSDB *meta, const char *ip, int port, bool is_mirror=false);
 	~Slave();
 	void start();
 	void stop();
 		
 	void set_id(const std::string &id);
+	// installs a checkpoint of the master as the db in dir, which must not
+	// exist, and saves the status of slave id to sync binlogs after it
+	static int bootstrap(SSDB *meta, const std::string &id, const std::string &host, int port, const std::string &auth, const std::string &dir);
 	std::string stats() const;
 };
 
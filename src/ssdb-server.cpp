@@ -58,17 +58,14 @@ void MyApplication::run(){
 	log_info("binlog           : %s", option.binlog ? "yes" : "no");
 	log_info("binlog_capacity  : %d", option.binlog_capacity);
 	log_info("wal              : %s", option.wal ? "yes" : "no");
+	log_info("group_commit     : %d KB", option.group_commit);
 	log_info("sync_speed       : %d MB/s", conf->get_num("replication.sync_speed"));
+	log_info("copy_speed       : %d MB/s", conf->get("replication.copy_speed")? conf->get_num("replication.copy_speed") : conf->get_num("replication.sync_speed"));
+	log_info("total_speed      : %d MB/s", conf->get_num("replication.total_speed"));
+	log_info("sync_window      : %d", conf->get_num("replication.sync_window"));
 
 	SSDB *data_db = NULL;
 	SSDB *meta_db = NULL;
-	data_db = SSDB::open(option, data_db_dir);
-	if(!data_db){
-		log_fatal("could not open data db: %s", data_db_dir.c_str());
-		fprintf(stderr, "could not open data db: %s\n", data_db_dir.c_str());
-		exit(1);
-	}
-
 	meta_db = SSDB::open(Options(), meta_db_dir);
 	if(!meta_db){
 		log_fatal("could not open meta db: %s", meta_db_dir.c_str());
@@ -76,6 +73,14 @@ void MyApplication::run(){
 		exit(1);
 	}
 
+	SSDBServer::bootstrap(*conf, meta_db, data_db_dir);
+	data_db = SSDB::open(option, data_db_dir);
+	if(!data_db){
+		log_fatal("could not open data db: %s", data_db_dir.c_str());
+		fprintf(stderr, "could not open data db: %s\n", data_db_dir.c_str());
+		exit(1);
+	}
+
 	SSDBServer *server;
 	NetworkServer *net = new NetworkServer(*conf);
 	server = new SSDBServer(data_db, meta_db, *conf, net);
@@ -83,12 +88,12 @@ void MyApplication::run(){
 	log_info("pidfile: %s, pid: %d", app_args.pidfile.c_str(), (int)getpid());
 	log_info("ssdb server started.");
 
-    pthread_t tids[SERVE_THREADS];
-    for (int i = 0; i < SERVE_THREADS; i++) {
+    std::vector<pthread_t> tids(net->serve_threads);
+    for (int i = 0; i < net->serve_threads; i++) {
         pthread_create(&tids[i], NULL, &NetworkServer::serve, (void*)net);
     }
 
-    for (int i = 0; i < SERVE_THREADS; i++) {
+    for (int i = 0; i < net->serve_threads; i++) {
         pthread_join(tids[i], NULL);
     }
 
@@ -0,0 +1,110 @@
+/*
+Copyright (c) 2012-2014 The SSDB Authors. All rights reserved.
+Use of this source code is governed by a BSD-style license that can be
+found in the LICENSE file.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <string>
+#include "chess_merge.h"
+
+// the find_if based merge ChessMergeOperator used to do
+static size_t legacy_merge(const Bytes *lists, int n, bool full, std::string *out){
+	std::vector<BytesPair> arr;
+	for(int i = 0; i < n; i++){
+		std::vector<BytesPair> exists;
+		if(get_hash_bytes(lists[i], exists) == -1){
+			continue;
+		}
+		arr.reserve(arr.size() + exists.size());
+		for(auto &item : exists){
+			auto it = std::find_if(arr.begin(), arr.end(), [&item](const BytesPair &p){
+				return (p.first == item.first);
+			});
+			if(it == arr.end()){
+				arr.emplace_back(item.first, item.second);
+			}
+		}
+	}
+	out->clear();
+	for(auto &item : arr){
+		if(full && *(const int16_t *)item.second.data() == 0x7FFF){
+			continue;
+		}
+		out->append(item.first.data(), item.first.size());
+		out->append(item.second.data(), item.second.size());
+	}
+	return out->size();
+}
+
+static std::string random_moves(int count, int del_percent){
+	std::string buf;
+	for(int i = 0; i < count; i++){
+		HashEntry e;
+		int src = rand() % 90;
+		int dst = rand() % 90;
+		e.move = (src << 8) + dst;
+		e.score = (rand() % 100 < del_percent)? 0x7FFF : (rand() % 2000) - 1000;
+		buf.append((const char *)&e, sizeof(e));
+	}
+	return buf;
+}
+
+int main(int argc, char **argv){
+	int positions = 10000;
+	int operands = 8;
+	int moves = 40;
+	if(argc > 1){
+		positions = atoi(argv[1]);
+	}
+	if(argc > 2){
+		operands = atoi(argv[2]);
+	}
+	if(argc > 3){
+		moves = atoi(argv[3]);
+	}
+	printf("positions: %d, operands: %d, moves: %d\n", positions, operands, moves);
+
+	srand(1);
+	// newest first, existing value last
+	std::vector<std::vector<std::string>> data(positions);
+	for(int i = 0; i < positions; i++){
+		for(int j = 0; j < operands; j++){
+			data[i].push_back(random_moves(1 + rand() % 4, 10));
+		}
+		data[i].push_back(random_moves(moves, 0));
+	}
+
+	std::string legacy_out, new_out;
+	std::vector<Bytes> lists;
+	double legacy_time = 0, new_time = 0;
+	int mismatch = 0;
+	for(int i = 0; i < positions; i++){
+		lists.clear();
+		size_t len = 0;
+		for(auto &s : data[i]){
+			lists.emplace_back(s.data(), s.size());
+			len += s.size();
+		}
+
+		double stime = microtime();
+		legacy_merge(lists.data(), lists.size(), true, &legacy_out);
+		legacy_time += microtime() - stime;
+
+		stime = microtime();
+		new_out.resize(len);
+		size_t pos = ChessMergeOperator::mergeMoves(lists.data(), lists.size(), true, false, &new_out[0]);
+		new_out.resize(pos);
+		new_time += microtime() - stime;
+
+		if(legacy_out != new_out){
+			mismatch ++;
+		}
+	}
+
+	printf("legacy: %8.3f us/merge\n", legacy_time * 1000000 / positions);
+	printf("bitmap: %8.3f us/merge\n", new_time * 1000000 / positions);
+	printf("mismatch: %d\n", mismatch);
+	return mismatch? 1 : 0;
+}
@@ -9,8 +9,11 @@ found in the LICENSE file.
 #include "../util/log.h"
 #include "../util/string_util.h"
 #include <unordered_map>
+#include <lz4.h>
 
 static __thread TERARKDB_NAMESPACE::WriteBatch* tls_batch;
+// transactions begun by this thread and not yet released
+static __thread int tls_depth;
 
 /* Binlog */
 
@@ -21,6 +24,16 @@ Binlog::Binlog(uint64_t seq, char type, char cmd, const TERARKDB_NAMESPACE::Slic
 	buf.append(key.data(), key.size());
 }
 
+Binlog::Binlog(uint64_t seq, char type, char cmd, const TERARKDB_NAMESPACE::Slice &key, const TERARKDB_NAMESPACE::Slice &val){
+	uint16_t key_len = (uint16_t)key.size();
+	buf.append((char *)(&seq), sizeof(uint64_t));
+	buf.push_back(type);
+	buf.push_back(cmd);
+	buf.append((char *)(&key_len), sizeof(uint16_t));
+	buf.append(key.data(), key.size());
+	buf.append(val.data(), val.size());
+}
+
 uint64_t Binlog::seq() const{
 	return *((uint64_t *)(buf.data()));
 }
@@ -33,10 +46,42 @@ char Binlog::cmd() const{
 	return buf[sizeof(uint64_t) + 1];
 }
 
+void Binlog::set_seq(uint64_t seq){
+	memcpy(&buf[0], &seq, sizeof(uint64_t));
+}
+
+// returns the key length of a length prefixed record, clamped to its size
+static inline int prefixed_key_len(const std::string &buf, int header_len){
+	if(buf.size() < header_len + sizeof(uint16_t)){
+		return -1;
+	}
+	uint16_t key_len = *((uint16_t *)(buf.data() + header_len));
+	return std::min((int)key_len, (int)(buf.size() - header_len - sizeof(uint16_t)));
+}
+
 const Bytes Binlog::key() const{
+	if(this->cmd() == BinlogCommand::HMERGE){
+		int key_len = prefixed_key_len(buf, HEADER_LEN);
+		if(key_len == -1){
+			return Bytes("", 0);
+		}
+		return Bytes(buf.data() + HEADER_LEN + sizeof(uint16_t), key_len);
+	}
 	return Bytes(buf.data() + HEADER_LEN, buf.size() - HEADER_LEN);
 }
 
+const Bytes Binlog::val() const{
+	if(this->cmd() != BinlogCommand::HMERGE){
+		return Bytes("", 0);
+	}
+	int key_len = prefixed_key_len(buf, HEADER_LEN);
+	if(key_len == -1){
+		return Bytes("", 0);
+	}
+	int pos = HEADER_LEN + sizeof(uint16_t) + key_len;
+	return Bytes(buf.data() + pos, buf.size() - pos);
+}
+
 int Binlog::load(const Bytes &s){
 	if(s.size() < HEADER_LEN){
 		return -1;
@@ -105,6 +150,9 @@ std::string Binlog::dumps() const{
 		case BinlogCommand::HDEL:
 			str.append("hdel ");
 			break;
+		case BinlogCommand::HMERGE:
+			str.append("hmerge ");
+			break;
 		case BinlogCommand::ZSET:
 			str.append("zset ");
 			break;
@@ -132,13 +180,112 @@ std::string Binlog::dumps() const{
 		case BinlogCommand::QSET:
 			str.append("qset ");
 			break;
+		case BinlogCommand::FRAME:
+			str.append("frame ");
+			break;
 	}
 	Bytes b = this->key();
 	str.append(hexmem(b.data(), b.size()));
+	if(this->cmd() == BinlogCommand::HMERGE){
+		Bytes v = this->val();
+		str.append(" ");
+		str.append(hexmem(v.data(), v.size()));
+	}
 	return str;
 }
 
 
+/* BinlogFrame */
+
+// per message: field count(1 byte), then length(4 bytes) and data of each
+void BinlogFrame::add_field(const Bytes &b){
+	uint32_t len = b.size();
+	buf.append((char *)&len, sizeof(len));
+	buf.append(b.data(), b.size());
+}
+
+void BinlogFrame::add(const Bytes &log){
+	buf.push_back(1);
+	add_field(log);
+	count_ ++;
+}
+
+void BinlogFrame::add(const Bytes &log, const Bytes &val){
+	buf.push_back(2);
+	add_field(log);
+	add_field(val);
+	count_ ++;
+}
+
+int BinlogFrame::encode(const std::string &codec, std::string *out) const{
+	if(codec == "raw"){
+		*out = buf;
+		return 0;
+	}
+	if(codec == "lz4"){
+		uint32_t raw_len = buf.size();
+		int bound = LZ4_compressBound(raw_len);
+		out->resize(sizeof(raw_len) + bound);
+		memcpy(&(*out)[0], &raw_len, sizeof(raw_len));
+		int len = LZ4_compress_default(buf.data(), &(*out)[sizeof(raw_len)], raw_len, bound);
+		if(len <= 0){
+			return -1;
+		}
+		out->resize(sizeof(raw_len) + len);
+		return 0;
+	}
+	return -1;
+}
+
+int BinlogFrame::decode(const Bytes &codec, const Bytes &data, std::string *raw, std::vector<std::vector<Bytes> > *reqs){
+	if(codec == "raw"){
+		raw->assign(data.data(), data.size());
+	}else if(codec == "lz4"){
+		uint32_t raw_len;
+		if(data.size() < (int)sizeof(raw_len)){
+			return -1;
+		}
+		memcpy(&raw_len, data.data(), sizeof(raw_len));
+		if(raw_len > 1024 * 1024 * 1024){
+			return -1;
+		}
+		raw->resize(raw_len);
+		int len = LZ4_decompress_safe(data.data() + sizeof(raw_len), &(*raw)[0],
+			data.size() - sizeof(raw_len), raw_len);
+		if(len != (int)raw_len){
+			return -1;
+		}
+	}else{
+		return -1;
+	}
+
+	reqs->clear();
+	const char *p = raw->data();
+	const char *end = p + raw->size();
+	while(p < end){
+		int n = *p++;
+		if(n < 1 || n > 2){
+			return -1;
+		}
+		reqs->push_back(std::vector<Bytes>());
+		for(int i = 0; i < n; i++){
+			uint32_t len;
+			if(end - p < (int)sizeof(len)){
+				return -1;
+			}
+			memcpy(&len, p, sizeof(len));
+			p += sizeof(len);
+			if(len > (uint32_t)(end - p)){
+				return -1;
+			}
+			reqs->back().push_back(Bytes(p, len));
+			p += len;
+		}
+	}
+	return 0;
+}
+
+
 /* SyncLogQueue */
 
 static inline std::string encode_seq_key(uint64_t seq){
@@ -158,22 +305,41 @@ static inline uint64_t decode_seq_key(const TERARKDB_NAMESPACE::Slice &key){
 	return seq;
 }
 
-BinlogQueue::BinlogQueue(TERARKDB_NAMESPACE::DB *db, std::vector<TERARKDB_NAMESPACE::ColumnFamilyHandle*> handles, bool enabled, int capacity, bool wal){
+BinlogQueue::BinlogQueue(TERARKDB_NAMESPACE::DB *db, std::vector<TERARKDB_NAMESPACE::ColumnFamilyHandle*> handles, bool enabled, int capacity, bool wal, bool wal_binlog){
 	this->db = db;
 	this->cfHandles = handles;
 	this->min_seq_ = 0;
 	this->last_seq = 0;
 	this->capacity = capacity;
 	this->enabled = enabled;
+	this->cache = NULL;
+	this->group_size = DEFAULT_GROUP_SIZE;
+	this->committed_seq_ = 0;
 	this->write_opts.disableWAL = !wal;
+	pthread_mutex_init(&group_mutex, NULL);
+	pthread_cond_init(&group_cond, NULL);
+	this->tail_waiters = 0;
+	pthread_mutex_init(&tail_mutex, NULL);
+	pthread_cond_init(&tail_cond, NULL);
+	this->wal_binlog = false;
 
 	if(!this->enabled){
 		return;
 	}
+	if(wal_binlog){
+		if(!wal){
+			log_error("binlog in wal requires rocksdb.wal, using oplog");
+		}else{
+			this->wal_binlog = true;
+			log_info("binlogs in wal, seq: %" PRIu64 "", this->max_seq());
+			return;
+		}
+	}
 
 	Binlog log;
 	if(this->find_last(&log) == 1){
 		this->last_seq = log.seq();
+		this->committed_seq_ = log.seq();
 	}
 	if(this->find_min(&log) == 1){
 		this->min_seq_ = log.seq();
@@ -195,7 +361,7 @@ BinlogQueue::BinlogQueue(TERARKDB_NAMESPACE::DB *db, std::vector<TERARKDB_NAMESP
 }
 
 BinlogQueue::~BinlogQueue(){
-	if(enabled){
+	if(enabled && !wal_binlog){
 		thread_quit = true;
 		for(int i=0; i<100; i++){
 			if(thread_quit == false){
@@ -210,22 +376,34 @@ BinlogQueue::~BinlogQueue(){
 		delete vec_batch.back();
 		vec_batch.pop_back();
 	}
+	pthread_mutex_destroy(&group_mutex);
+	pthread_cond_destroy(&group_cond);
+	pthread_mutex_destroy(&tail_mutex);
+	pthread_cond_destroy(&tail_cond);
 }
 
 std::string BinlogQueue::stats() const{
 	std::string s;
-	s.append("    capacity : " + str(capacity) + "\n");
+	if(wal_binlog){
+		s.append("    source   : wal\n");
+	}else{
+		s.append("    capacity : " + str(capacity) + "\n");
+	}
 	s.append("    min_seq  : " + str(min_seq_) + "\n");
-	s.append("    max_seq  : " + str(last_seq) + "");
+	s.append("    max_seq  : " + str(max_seq()) + "");
 	return s;
 }
 
 void BinlogQueue::begin(){
+	if(tls_depth++ > 0){
+		// joins the outer transaction, which holds the lock
+		return;
+	}
 	if(terark_unlikely(tls_batch == nullptr)){
 		tls_batch = new TERARKDB_NAMESPACE::WriteBatch();
 		mutex.lock();
 		vec_batch.push_back(tls_batch);
-		if(!enabled){
+		if(!enabled || wal_binlog){
 			mutex.unlock();
 		}
 	} else {
@@ -234,36 +412,234 @@ void BinlogQueue::begin(){
 }
 
 void BinlogQueue::lock(){
-	if(enabled){
+	if(enabled && !wal_binlog){
 		mutex.lock();
 	}
 }
 void BinlogQueue::unlock(){
-	if(enabled){
+	if(enabled && !wal_binlog){
 		mutex.unlock();
 	}
 }
 
+uint64_t BinlogQueue::max_seq() const{
+	if(wal_binlog){
+		return db->GetLatestSequenceNumber();
+	}
+	return last_seq;
+}
+
+uint64_t BinlogQueue::committed_seq() const{
+	if(wal_binlog){
+		return db->GetLatestSequenceNumber();
+	}
+	return committed_seq_.load(std::memory_order_acquire);
+}
+
 void BinlogQueue::release(){
+	if(--tls_depth > 0){
+		return;
+	}
 	tls_batch->Clear();
 }
 
+class CacheInvalidator : public TERARKDB_NAMESPACE::WriteBatch::Handler{
+private:
+	ValueCache *cache;
+	void erase(uint32_t cf, const TERARKDB_NAMESPACE::Slice &key){
+		if(cf == kDefaultCFHandle){
+			cache->erase(key.ToString());
+		}
+	}
+public:
+	CacheInvalidator(ValueCache *cache){
+		this->cache = cache;
+	}
+	virtual TERARKDB_NAMESPACE::Status PutCF(uint32_t cf, const TERARKDB_NAMESPACE::Slice &key, const TERARKDB_NAMESPACE::Slice &value){
+		erase(cf, key);
+		return TERARKDB_NAMESPACE::Status::OK();
+	}
+	virtual TERARKDB_NAMESPACE::Status DeleteCF(uint32_t cf, const TERARKDB_NAMESPACE::Slice &key){
+		erase(cf, key);
+		return TERARKDB_NAMESPACE::Status::OK();
+	}
+	virtual TERARKDB_NAMESPACE::Status MergeCF(uint32_t cf, const TERARKDB_NAMESPACE::Slice &key, const TERARKDB_NAMESPACE::Slice &value){
+		erase(cf, key);
+		return TERARKDB_NAMESPACE::Status::OK();
+	}
+};
+
+// copies the operations of a batch into another one
+class BatchAppender : public TERARKDB_NAMESPACE::WriteBatch::Handler{
+private:
+	TERARKDB_NAMESPACE::WriteBatch *dst;
+	const std::vector<TERARKDB_NAMESPACE::ColumnFamilyHandle*> &cfHandles;
+public:
+	BatchAppender(TERARKDB_NAMESPACE::WriteBatch *dst, const std::vector<TERARKDB_NAMESPACE::ColumnFamilyHandle*> &handles)
+		: dst(dst), cfHandles(handles){
+	}
+	virtual TERARKDB_NAMESPACE::Status PutCF(uint32_t cf, const TERARKDB_NAMESPACE::Slice &key, const TERARKDB_NAMESPACE::Slice &value){
+		return dst->Put(cfHandles[cf], key, value);
+	}
+	virtual TERARKDB_NAMESPACE::Status DeleteCF(uint32_t cf, const TERARKDB_NAMESPACE::Slice &key){
+		return dst->Delete(cfHandles[cf], key);
+	}
+	virtual TERARKDB_NAMESPACE::Status MergeCF(uint32_t cf, const TERARKDB_NAMESPACE::Slice &key, const TERARKDB_NAMESPACE::Slice &value){
+		return dst->Merge(cfHandles[cf], key, value);
+	}
+	virtual TERARKDB_NAMESPACE::Status DeleteRangeCF(uint32_t cf, const TERARKDB_NAMESPACE::Slice &begin, const TERARKDB_NAMESPACE::Slice &end){
+		return dst->DeleteRange(cfHandles[cf], begin, end);
+	}
+	virtual void LogData(const TERARKDB_NAMESPACE::Slice &blob){
+		dst->PutLogData(blob);
+	}
+};
+
+struct BinlogWriter{
+	TERARKDB_NAMESPACE::WriteBatch *batch;
+	uint64_t seq;
+	bool done;
+	TERARKDB_NAMESPACE::Status status;
+};
+
 TERARKDB_NAMESPACE::Status BinlogQueue::commit(){
+	if(tls_depth > 1){
+		// written by the outermost commit
+		return TERARKDB_NAMESPACE::Status::OK();
+	}
+	BinlogWriter w;
+	w.batch = tls_batch;
+	w.seq = last_seq;
+	w.done = false;
+
+	pthread_mutex_lock(&group_mutex);
+	// queued before the seq lock is released, so groups are in seq order
+	writers.push_back(&w);
 	unlock();
-	TERARKDB_NAMESPACE::Status s = db->Write(write_opts, tls_batch);
-	return s;
+	while(!w.done && writers.front() != &w){
+		pthread_cond_wait(&group_cond, &group_mutex);
+	}
+	if(!w.done){
+		write_group();
+	}
+	pthread_mutex_unlock(&group_mutex);
+
+	if(cache){
+		// after the write, so a reader can't cache the value it replaces
+		CacheInvalidator invalidator(cache);
+		tls_batch->Iterate(&invalidator);
+	}
+	return w.status;
+}
+
+// called by the front writer with group_mutex held
+void BinlogQueue::write_group(){
+	std::vector<BinlogWriter *> group;
+	size_t size = 0;
+	for(auto w : writers){
+		size_t n = w->batch->GetDataSize();
+		if(!group.empty() && size + n > group_size){
+			break;
+		}
+		group.push_back(w);
+		size += n;
+	}
+	pthread_mutex_unlock(&group_mutex);
+
+	// followers in the group are blocked, their batches can be read safely
+	TERARKDB_NAMESPACE::WriteBatch *batch = group[0]->batch;
+	if(group.size() > 1){
+		group_batch.Clear();
+		BatchAppender appender(&group_batch, cfHandles);
+		for(auto w : group){
+			w->batch->Iterate(&appender);
+		}
+		batch = &group_batch;
+	}
+	TERARKDB_NAMESPACE::Status s = db->Write(write_opts, batch);
+
+	pthread_mutex_lock(&group_mutex);
+	for(size_t i = 0; i < group.size(); i++){
+		BinlogWriter *w = writers.front();
+		writers.pop_front();
+		w->status = s;
+		w->done = true;
+	}
+	if(s.ok() && group.back()->seq > committed_seq_.load(std::memory_order_relaxed)){
+		committed_seq_.store(group.back()->seq, std::memory_order_seq_cst);
+	}
+	pthread_cond_broadcast(&group_cond);
+	// pairs with the fence in wait_for(): either the waiter sees the new
+	// seq, or this sees the waiter. In wal mode the seq is stored by the
+	// engine, so the fence is what orders it
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if(s.ok() && tail_waiters.load() > 0){
+		pthread_mutex_lock(&tail_mutex);
+		pthread_cond_broadcast(&tail_cond);
+		pthread_mutex_unlock(&tail_mutex);
+	}
+}
+
+bool BinlogQueue::wait_for(uint64_t seq, int timeout_ms){
+	if(committed_seq() >= seq){
+		return true;
+	}
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += timeout_ms / 1000;
+	ts.tv_nsec += (timeout_ms % 1000) * 1000 * 1000;
+	if(ts.tv_nsec >= 1000 * 1000 * 1000){
+		ts.tv_sec += 1;
+		ts.tv_nsec -= 1000 * 1000 * 1000;
+	}
+	pthread_mutex_lock(&tail_mutex);
+	tail_waiters ++;
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	while(committed_seq() < seq){
+		if(pthread_cond_timedwait(&tail_cond, &tail_mutex, &ts) == ETIMEDOUT){
+			break;
+		}
+	}
+	tail_waiters --;
+	pthread_mutex_unlock(&tail_mutex);
+	return committed_seq() >= seq;
 }
 
 void BinlogQueue::add_log(char type, char cmd, const TERARKDB_NAMESPACE::Slice &key){
 	if(!enabled){
 		return;
 	}
+	if(wal_binlog){
+		// seq is assigned by WalLogReader
+		Binlog log(0, type, cmd, key);
+		tls_batch->PutLogData(log.repr());
+		return;
+	}
 	last_seq++;
 	Binlog log(last_seq, type, cmd, key);
 	tls_batch->Put(cfHandles[kOplogCFHandle], encode_seq_key(last_seq), log.repr());
 }
 
+void BinlogQueue::add_log(char type, char cmd, const TERARKDB_NAMESPACE::Slice &key, const TERARKDB_NAMESPACE::Slice &val){
+	if(!enabled){
+		return;
+	}
+	if(wal_binlog){
+		Binlog log(0, type, cmd, key, val);
+		tls_batch->PutLogData(log.repr());
+		return;
+	}
+	last_seq++;
+	Binlog log(last_seq, type, cmd, key, val);
+	tls_batch->Put(cfHandles[kOplogCFHandle], encode_seq_key(last_seq), log.repr());
+}
+
 int BinlogQueue::find_next(uint64_t next_seq, Binlog *log) const{
+	// nothing to seek for, an idle sync client would create an
+	// iterator on every tick otherwise
+	if(next_seq > this->committed_seq()){
+		return 0;
+	}
 	if(this->get(next_seq, log) == 1){
 		return 1;
 	}
@@ -307,9 +683,13 @@ int BinlogQueue::find_min(Binlog *log) const{
 }
 
 int BinlogQueue::find_last(Binlog *log) const{
+	return find_last(db, cfHandles[kOplogCFHandle], log);
+}
+
+int BinlogQueue::find_last(TERARKDB_NAMESPACE::DB *db, TERARKDB_NAMESPACE::ColumnFamilyHandle *cf, Binlog *log){
 	int ret = 0;
 	std::string key_str = encode_seq_key(UINT64_MAX);
-	TERARKDB_NAMESPACE::Iterator *it = db->NewIterator(read_opts, cfHandles[kOplogCFHandle]);
+	TERARKDB_NAMESPACE::Iterator *it = db->NewIterator(TERARKDB_NAMESPACE::ReadOptions(), cf);
 	it->Seek(key_str);
 	if(!it->Valid()){
 		// Iterator::prev requires Valid, so we seek to last
@@ -362,6 +742,9 @@ int BinlogQueue::del(uint64_t seq){
 }
 
 void BinlogQueue::flush(){
+	if(wal_binlog){
+		return;
+	}
 	Locking l(&mutex);
 	del_range(min_seq_, last_seq);
 }
@@ -453,3 +836,82 @@ void BinlogQueue::Delete(const TERARKDB_NAMESPACE::Slice& key){
 void BinlogQueue::Merge(const TERARKDB_NAMESPACE::Slice& key, const TERARKDB_NAMESPACE::Slice& value){
 	tls_batch->Merge(key, value);
 }
+
+/* WalLogReader */
+
+class LogDataCollector : public TERARKDB_NAMESPACE::WriteBatch::Handler{
+public:
+	std::vector<std::string> blobs;
+	virtual void LogData(const TERARKDB_NAMESPACE::Slice &blob){
+		blobs.push_back(blob.ToString());
+	}
+};
+
+WalLogReader::WalLogReader(const BinlogQueue *logs){
+	this->db = logs->db;
+	this->pending_pos = 0;
+	this->next_batch = 0;
+}
+
+// reads the next batch holding logs into pending
+int WalLogReader::read_batch(uint64_t seq){
+	pending.clear();
+	pending_pos = 0;
+	while(pending.empty()){
+		// the batch read next must start at or before this
+		uint64_t expect = next_batch;
+		if(!iter || !iter->Valid()){
+			// an exhausted iterator doesn't see later writes, reopen it
+			iter.reset();
+			expect = std::max(seq, next_batch);
+			if(expect > db->GetLatestSequenceNumber()){
+				return 0;
+			}
+			TERARKDB_NAMESPACE::Status s = db->GetUpdatesSince(expect, &iter);
+			if(!s.ok()){
+				log_error("GetUpdatesSince %" PRIu64 " error: %s", expect, s.ToString().c_str());
+				iter.reset();
+				return -1;
+			}
+			if(!iter->Valid()){
+				iter.reset();
+				return 0;
+			}
+		}
+		TERARKDB_NAMESPACE::BatchResult batch = iter->GetBatch();
+		if(batch.sequence > expect){
+			// the batch holding expect has been purged
+			log_error("wal gap, want: %" PRIu64 ", got: %" PRIu64 "", expect, batch.sequence);
+			iter.reset();
+			return -1;
+		}
+		LogDataCollector collector;
+		batch.writeBatchPtr->Iterate(&collector);
+		for(size_t i = 0; i < collector.blobs.size(); i++){
+			uint64_t log_seq = batch.sequence + i;
+			Binlog log;
+			if(log_seq < seq || log.load(collector.blobs[i]) == -1){
+				continue;
+			}
+			log.set_seq(log_seq);
+			pending.push_back(log);
+		}
+		next_batch = batch.sequence + batch.writeBatchPtr->Count();
+		iter->Next();
+	}
+	return 1;
+}
+
+int WalLogReader::find_next(uint64_t seq, Binlog *log){
+	while(pending_pos < pending.size() && pending[pending_pos].seq() < seq){
+		pending_pos ++;
+	}
+	if(pending_pos == pending.size()){
+		int ret = read_batch(seq);
+		if(ret != 1){
+			return ret;
+		}
+	}
+	*log = pending[pending_pos++];
+	return 1;
+}
@@ -7,13 +7,17 @@ found in the LICENSE file.
 #define SSDB_BINLOG_H_
 
 #include <string>
+#include <deque>
+#include <atomic>
 #include "rocksdb/db.h"
 #include "rocksdb/options.h"
 #include "rocksdb/slice.h"
 #include "rocksdb/status.h"
 #include "rocksdb/write_batch.h"
+#include "rocksdb/transaction_log.h"
 #include "../util/thread.h"
 #include "../util/bytes.h"
+#include "cache.h"
 
 inline
 static TERARKDB_NAMESPACE::Slice slice(const Bytes &b){
@@ -27,6 +31,8 @@ private:
 public:
 	Binlog(){}
 	Binlog(uint64_t seq, char type, char cmd, const TERARKDB_NAMESPACE::Slice &key);
+	// key is length prefixed, followed by val, for HMERGE
+	Binlog(uint64_t seq, char type, char cmd, const TERARKDB_NAMESPACE::Slice &key, const TERARKDB_NAMESPACE::Slice &val);
 		
 	int load(const Bytes &s);
 	int load(const TERARKDB_NAMESPACE::Slice &s);
@@ -36,6 +42,9 @@ public:
 	char type() const;
 	char cmd() const;
 	const Bytes key() const;
+	// merge operand of HMERGE, empty for other commands
+	const Bytes val() const;
+	void set_seq(uint64_t seq);
 
 	const char* data() const{
 		return buf.data();
@@ -49,9 +58,42 @@ public:
 	std::string dumps() const;
 };
 
+// Binlogs and their values packed into one message, sent by a master to
+// slaves that asked for it, raw or compressed with lz4.
+class BinlogFrame{
+private:
+	std::string buf;
+	int count_;
+	void add_field(const Bytes &b);
+public:
+	BinlogFrame(){
+		count_ = 0;
+	}
+	void add(const Bytes &log);
+	void add(const Bytes &log, const Bytes &val);
+	void clear(){
+		buf.clear();
+		count_ = 0;
+	}
+	int count() const{
+		return count_;
+	}
+	size_t size() const{
+		return buf.size();
+	}
+	// codec: "raw" or "lz4", returns -1 on error
+	int encode(const std::string &codec, std::string *out) const;
+	// requests in reqs point into raw
+	static int decode(const Bytes &codec, const Bytes &data, std::string *raw, std::vector<std::vector<Bytes> > *reqs);
+};
+
+struct BinlogWriter;
+class WalLogReader;
+
 // circular queue
 class BinlogQueue{
 private:
+	friend class WalLogReader;
 	TERARKDB_NAMESPACE::DB *db;
 	std::vector<TERARKDB_NAMESPACE::ColumnFamilyHandle*> cfHandles;
 	uint64_t min_seq_;
@@ -62,6 +104,24 @@ private:
 	std::vector<TERARKDB_NAMESPACE::WriteBatch*> vec_batch;
 	Mutex mutex;
 	bool enabled;
+	// logs are LogData records in the engine WAL, seqs are engine seqs
+	bool wal_binlog;
+	ValueCache *cache;
+
+	// group commit, committers queue up in seq order and the one in front
+	// writes its own batch and those queued behind it in one db->Write
+	pthread_mutex_t group_mutex;
+	pthread_cond_t group_cond;
+	std::deque<BinlogWriter *> writers;
+	size_t group_size;
+	TERARKDB_NAMESPACE::WriteBatch group_batch;
+	std::atomic<uint64_t> committed_seq_;
+	void write_group();
+
+	// sync clients waiting for logs to be committed
+	pthread_mutex_t tail_mutex;
+	pthread_cond_t tail_cond;
+	std::atomic<int> tail_waiters;
 
 	volatile bool thread_quit;
 	static void* log_clean_thread_func(void *arg);
@@ -73,13 +133,22 @@ private:
 	void merge();
 
 public:
-	BinlogQueue(TERARKDB_NAMESPACE::DB *db, std::vector<TERARKDB_NAMESPACE::ColumnFamilyHandle*> handles, bool enabled=true, int capacity=20000000, bool wal=true);
+	BinlogQueue(TERARKDB_NAMESPACE::DB *db, std::vector<TERARKDB_NAMESPACE::ColumnFamilyHandle*> handles, bool enabled=true, int capacity=20000000, bool wal=true, bool wal_binlog=false);
 	~BinlogQueue();
 	void begin();
 	void lock();
 	void unlock();
 	void release();
 	TERARKDB_NAMESPACE::Status commit();
+	// keys written by commit() are erased from cache afterwards
+	void set_cache(ValueCache *cache){
+		this->cache = cache;
+	}
+	// bytes of batches a group commit writes at most, 0: one at a time
+	static const size_t DEFAULT_GROUP_SIZE = 64 * 1024;
+	void set_group_size(size_t size){
+		this->group_size = size;
+	}
 	void add_log(char type, char cmd, const TERARKDB_NAMESPACE::Slice &key);
 	void add_log(char type, char cmd, const std::string &key){
 		if(!enabled){
@@ -87,6 +156,7 @@ public:
 		}
 		add_log(type, cmd, slice(key));
 	}
+	void add_log(char type, char cmd, const TERARKDB_NAMESPACE::Slice &key, const TERARKDB_NAMESPACE::Slice &val);
 
 	// rocksdb put
 	void Put(const TERARKDB_NAMESPACE::Slice& key, const TERARKDB_NAMESPACE::Slice& value);
@@ -108,16 +178,50 @@ public:
 	int find_next(uint64_t seq, Binlog *log) const;
 	int find_min(Binlog *log) const;
 	int find_last(Binlog *log) const;
+	// the last log in the oplog column family cf of db
+	static int find_last(TERARKDB_NAMESPACE::DB *db, TERARKDB_NAMESPACE::ColumnFamilyHandle *cf, Binlog *log);
 
+	bool is_wal() const{
+		return wal_binlog;
+	}
+	// 0 in wal mode, where retention is up to the engine
 	uint64_t min_seq() const{
 		return min_seq_;
 	}
-	uint64_t max_seq() const{
-		return last_seq;
-	}
+	uint64_t max_seq() const;
+	// all logs up to this seq have been written to db
+	uint64_t committed_seq() const;
+	// waits until seq is committed or timeout, returns false on timeout
+	bool wait_for(uint64_t seq, int timeout_ms);
 	std::string stats() const;
 };
 
+// Reads binlogs back from the engine WAL, for BinlogQueue in wal mode.
+// The i-th log of a write batch gets seq batch_seq + i. Every log is
+// written along with at least one update, so seqs never overlap.
+class WalLogReader{
+private:
+	TERARKDB_NAMESPACE::DB *db;
+	std::unique_ptr<TERARKDB_NAMESPACE::TransactionLogIterator> iter;
+	std::vector<Binlog> pending;
+	size_t pending_pos;
+	// engine seq the batch after the last one read starts at, 0 if none
+	// read yet. A batch takes Count() seqs but may hold fewer logs.
+	uint64_t next_batch;
+	int read_batch(uint64_t seq);
+public:
+	WalLogReader(const BinlogQueue *logs);
+	/** @returns
+	 1 : log.seq greater than or equal to seq
+	 0 : not found
+	 -1: error, seq is no longer in the WAL
+	 */
+	int find_next(uint64_t seq, Binlog *log);
+};
+
+// Transactions nest, an inner one only adds to the batch of the outer one,
+// which is written by the outer commit(). Reads within it don't see the
+// pending writes.
 class Transaction{
 private:
 	BinlogQueue *logs;
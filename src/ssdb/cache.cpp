@@ -0,0 +1,145 @@
+/*
+Copyright (c) 2012-2014 The SSDB Authors. All rights reserved.
+Use of this source code is governed by a BSD-style license that can be
+found in the LICENSE file.
+*/
+#include <string.h>
+#include <functional>
+#include "cache.h"
+#include "../util/string_util.h"
+
+static inline size_t key_hash(const std::string &key){
+	return std::hash<std::string>()(key);
+}
+
+ValueCache::ValueCache(size_t capacity){
+	shard_capacity = capacity / SHARDS;
+	hits = 0;
+	misses = 0;
+	for(int i = 0; i < SHARDS; i++){
+		shards[i].hand = 0;
+		shards[i].usage = 0;
+		memset(shards[i].gens, 0, sizeof(shards[i].gens));
+	}
+}
+
+ValueCache::~ValueCache(){
+}
+
+bool ValueCache::get(const std::string &key, std::string *val, uint64_t *gen){
+	size_t h = key_hash(key);
+	Shard *shard = &shards[h % SHARDS];
+	Locking l(&shard->mutex);
+	auto it = shard->index.find(key);
+	if(it == shard->index.end()){
+		*gen = shard->gens[(h / SHARDS) % GENS];
+		misses.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	Entry &e = shard->slots[it->second];
+	e.ref = true;
+	*val = e.val;
+	hits.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+void ValueCache::put(const std::string &key, const std::string &val, uint64_t gen){
+	size_t need = 2 * key.size() + val.size() + sizeof(Entry);
+	if(need > shard_capacity){
+		return;
+	}
+	size_t h = key_hash(key);
+	Shard *shard = &shards[h % SHARDS];
+	Locking l(&shard->mutex);
+	if(shard->gens[(h / SHARDS) % GENS] != gen){
+		return;
+	}
+	if(shard->index.find(key) != shard->index.end()){
+		return;
+	}
+	evict(shard, need);
+
+	int slot;
+	if(!shard->free_slots.empty()){
+		slot = shard->free_slots.back();
+		shard->free_slots.pop_back();
+	}else{
+		slot = (int)shard->slots.size();
+		shard->slots.emplace_back();
+	}
+	Entry &e = shard->slots[slot];
+	e.key = key;
+	e.val = val;
+	e.used = true;
+	e.ref = false;
+	shard->index[key] = slot;
+	shard->usage += charge(e);
+}
+
+void ValueCache::erase(const std::string &key){
+	size_t h = key_hash(key);
+	Shard *shard = &shards[h % SHARDS];
+	Locking l(&shard->mutex);
+	shard->gens[(h / SHARDS) % GENS] ++;
+	auto it = shard->index.find(key);
+	if(it != shard->index.end()){
+		remove(shard, it->second);
+	}
+}
+
+void ValueCache::clear(){
+	for(int i = 0; i < SHARDS; i++){
+		Shard *shard = &shards[i];
+		Locking l(&shard->mutex);
+		for(int j = 0; j < GENS; j++){
+			shard->gens[j] ++;
+		}
+		shard->index.clear();
+		shard->slots.clear();
+		shard->free_slots.clear();
+		shard->hand = 0;
+		shard->usage = 0;
+	}
+}
+
+std::string ValueCache::stats() const{
+	size_t usage = 0;
+	size_t entries = 0;
+	for(int i = 0; i < SHARDS; i++){
+		// racy read, for display only
+		usage += shards[i].usage;
+		entries += shards[i].slots.size() - shards[i].free_slots.size();
+	}
+	std::string s;
+	s.append("    capacity : " + str((uint64_t)shard_capacity * SHARDS) + "\n");
+	s.append("    usage    : " + str((uint64_t)usage) + "\n");
+	s.append("    entries  : " + str((uint64_t)entries) + "\n");
+	s.append("    hits     : " + str(hits.load(std::memory_order_relaxed)) + "\n");
+	s.append("    misses   : " + str(misses.load(std::memory_order_relaxed)) + "");
+	return s;
+}
+
+void ValueCache::evict(Shard *shard, size_t need){
+	int n = (int)shard->slots.size();
+	for(int steps = 0; shard->usage + need > shard_capacity && steps < 2 * n; steps++){
+		Entry &e = shard->slots[shard->hand];
+		if(e.used){
+			if(e.ref){
+				e.ref = false;
+			}else{
+				remove(shard, shard->hand);
+			}
+		}
+		shard->hand = (shard->hand + 1) % n;
+	}
+}
+
+void ValueCache::remove(Shard *shard, int slot){
+	Entry &e = shard->slots[slot];
+	shard->usage -= charge(e);
+	shard->index.erase(e.key);
+	std::string().swap(e.key);
+	std::string().swap(e.val);
+	e.used = false;
+	shard->free_slots.push_back(slot);
+}
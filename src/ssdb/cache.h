@@ -0,0 +1,68 @@
+/*
+Copyright (c) 2012-2014 The SSDB Authors. All rights reserved.
+Use of this source code is governed by a BSD-style license that can be
+found in the LICENSE file.
+*/
+#ifndef SSDB_CACHE_H_
+#define SSDB_CACHE_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <unordered_map>
+#include "../util/thread.h"
+
+// Resolved values of hot keys, sharded by key and evicted with CLOCK
+// once a shard exceeds its share of capacity bytes.
+//
+// Writers erase() keys after their batch is written. A reader takes a
+// generation with get() before reading the engine and passes it to put(),
+// which drops the value if the key was erased in between.
+class ValueCache{
+public:
+	ValueCache(size_t capacity);
+	~ValueCache();
+
+	// returns true on hit, otherwise *gen is set for the following put()
+	bool get(const std::string &key, std::string *val, uint64_t *gen);
+	void put(const std::string &key, const std::string &val, uint64_t gen);
+	void erase(const std::string &key);
+	void clear();
+
+	std::string stats() const;
+
+private:
+	static const int SHARDS = 64;
+	static const int GENS = 64;
+
+	struct Entry{
+		std::string key;
+		std::string val;
+		bool used;
+		bool ref;
+	};
+	struct Shard{
+		Mutex mutex;
+		std::unordered_map<std::string, int> index;
+		std::vector<Entry> slots;
+		std::vector<int> free_slots;
+		int hand;
+		size_t usage;
+		// bumped by erase(), one per group of keys
+		uint64_t gens[GENS];
+	};
+
+	Shard shards[SHARDS];
+	size_t shard_capacity;
+	std::atomic<uint64_t> hits;
+	std::atomic<uint64_t> misses;
+
+	static size_t charge(const Entry &e){
+		return 2 * e.key.size() + e.val.size() + sizeof(Entry);
+	}
+	void evict(Shard *shard, size_t need);
+	void remove(Shard *shard, int slot);
+};
+
+#endif
@@ -0,0 +1,92 @@
+/*
+Copyright (c) 2012-2014 The SSDB Authors. All rights reserved.
+Use of this source code is governed by a BSD-style license that can be
+found in the LICENSE file.
+*/
+#include "canonical.h"
+#include "../util/log.h"
+
+static const int kFiles = 9;
+static const int kRanks = 10;
+
+NameCanonicalizer* NameCanonicalizer::create(const std::string &type){
+	if(type.empty() || type == "none"){
+		return NULL;
+	}
+	if(type == "xiangqi_mirror"){
+		return new XiangqiMirrorCanonicalizer();
+	}
+	log_error("unknown hash canonicalizer: %s", type.c_str());
+	return NULL;
+}
+
+// mirrors the board part of a FEN, returns -1 if it is not a 9x10 board
+static int mirror_board(const char *board, int size, std::string *out){
+	char squares[kFiles];
+	int ranks = 0;
+	int pos = 0;
+	out->reserve(size);
+	while(pos <= size){
+		int files = 0;
+		for(; pos < size && board[pos] != '/'; pos++){
+			char c = board[pos];
+			if(c >= '1' && c <= '9'){
+				int n = c - '0';
+				if(files + n > kFiles){
+					return -1;
+				}
+				for(int i = 0; i < n; i++){
+					squares[files++] = 0;
+				}
+			}else{
+				if(files == kFiles){
+					return -1;
+				}
+				squares[files++] = c;
+			}
+		}
+		if(files != kFiles || ++ranks > kRanks){
+			return -1;
+		}
+		if(ranks > 1){
+			out->push_back('/');
+		}
+		int empty = 0;
+		for(int i = kFiles - 1; i >= 0; i--){
+			if(squares[i] == 0){
+				empty ++;
+				continue;
+			}
+			if(empty){
+				out->push_back('0' + empty);
+				empty = 0;
+			}
+			out->push_back(squares[i]);
+		}
+		if(empty){
+			out->push_back('0' + empty);
+		}
+		pos ++;
+	}
+	return ranks == kRanks? 0 : -1;
+}
+
+bool XiangqiMirrorCanonicalizer::canonicalize(const Bytes &name, std::string *canonical) const{
+	const char *data = name.data();
+	int board_size = 0;
+	while(board_size < name.size() && data[board_size] != ' '){
+		board_size ++;
+	}
+	std::string mirrored;
+	if(mirror_board(data, board_size, &mirrored) == -1){
+		canonical->assign(data, name.size());
+		return false;
+	}
+	mirrored.append(data + board_size, name.size() - board_size);
+	if(Bytes(mirrored) < name){
+		canonical->swap(mirrored);
+		return true;
+	}
+	canonical->assign(data, name.size());
+	return false;
+}
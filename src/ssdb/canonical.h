@@ -0,0 +1,38 @@
+/*
+Copyright (c) 2012-2014 The SSDB Authors. All rights reserved.
+Use of this source code is governed by a BSD-style license that can be
+found in the LICENSE file.
+*/
+#ifndef SSDB_CANONICAL_H_
+#define SSDB_CANONICAL_H_
+
+#include <string>
+#include "../util/bytes.h"
+
+// Maps a position name to the name its moves are stored under.
+class NameCanonicalizer
+{
+public:
+	virtual ~NameCanonicalizer(){}
+	virtual const char* name() const = 0;
+	// returns true if the canonical position is the left-right mirror of
+	// name, in which case files of stored moves are mirrored as well
+	virtual bool canonicalize(const Bytes &name, std::string *canonical) const = 0;
+
+	// NULL for "none" or an unknown type
+	static NameCanonicalizer* create(const std::string &type);
+};
+
+// Xiangqi positions named by FEN(board, then optional fields after a
+// space). A position and its mirror share an entry under the smaller of
+// the two names. Names that don't parse as a 9x10 board are kept as is.
+class XiangqiMirrorCanonicalizer : public NameCanonicalizer
+{
+public:
+	virtual const char* name() const{
+		return "xiangqi_mirror";
+	}
+	virtual bool canonicalize(const Bytes &name, std::string *canonical) const;
+};
+
+#endif
@@ -6,9 +6,15 @@
 #include "t_hash.h"
 
 class ChessCompactionFilter : public TERARKDB_NAMESPACE::CompactionFilter {
+	// drop kMinPly entries and resolved tombstones
+	bool prune;
+	// rewrite values into the sorted layout
+	bool sort;
 public:
 	static const int16_t kMinPly = 0;
 
+	ChessCompactionFilter(bool prune, bool sort) : prune(prune), sort(sort) {}
+
 	const char* Name() const override {
 		return "ChessCompactionFilter";
 	}
@@ -28,6 +34,10 @@ public:
 			return Decision::kKeep;
 		}
 		const TERARKDB_NAMESPACE::Slice& val = existing_value.slice();
+		if (val.empty() && value_type == ValueType::kValue) {
+			// every move deleted by blind hdel
+			return Decision::kRemove;
+		}
 		if (val.empty() || val.size() % (2 * sizeof(int16_t)) != 0) {
 			return Decision::kKeep;
 		}
@@ -36,29 +46,39 @@ public:
 		const int count = val.size() / entry_size;
 		bool needs_filter = false;
 
-		for (int i = 0; i < count; i++) {
-			int16_t field = *(const int16_t*)(val.data() + i * entry_size);
-			int16_t value = *(const int16_t*)(val.data() + i * entry_size + sizeof(int16_t));
-			if (field == kMinPly || (value_type == ValueType::kValue && value == 0x7FFF)) {
-				needs_filter = true;
-				break;
+		if (prune) {
+			for (int i = 0; i < count; i++) {
+				int16_t field = *(const int16_t*)(val.data() + i * entry_size);
+				int16_t value = *(const int16_t*)(val.data() + i * entry_size + sizeof(int16_t));
+				if (field == kMinPly || (value_type == ValueType::kValue && value == 0x7FFF)) {
+					needs_filter = true;
+					break;
+				}
 			}
 		}
+		bool needs_sort = sort && !hash_value_sorted(val.data(), count);
 
-		if (!needs_filter) {
+		if (!needs_filter && !needs_sort) {
 			return Decision::kKeep;
 		}
 
 		std::string* out = new_value->trans_to_string();
 		out->clear();
 		out->reserve(val.size());
-		for (int i = 0; i < count; i++) {
-			const char* entry = val.data() + i * entry_size;
-			int16_t field = *(const int16_t*)entry;
-			int16_t value = *(const int16_t*)(entry + sizeof(int16_t));
-			if (field != kMinPly && !(value_type == ValueType::kValue && value == 0x7FFF)) {
-				out->append(entry, entry_size);
+		if (needs_filter) {
+			for (int i = 0; i < count; i++) {
+				const char* entry = val.data() + i * entry_size;
+				int16_t field = *(const int16_t*)entry;
+				int16_t value = *(const int16_t*)(entry + sizeof(int16_t));
+				if (field != kMinPly && !(value_type == ValueType::kValue && value == 0x7FFF)) {
+					out->append(entry, entry_size);
+				}
 			}
+		} else {
+			out->assign(val.data(), val.size());
+		}
+		if (needs_sort) {
+			out->resize(sort_hash_entries(&(*out)[0], out->size() / entry_size) * entry_size);
 		}
 
 		if (out->empty()) {
@@ -71,6 +91,9 @@ public:
 class ChessCompactionFilterFactory : public TERARKDB_NAMESPACE::CompactionFilterFactory {
 public:
 	bool prune = false;
+	bool sorted = false;
+	// remove values left empty by tombstone merges
+	bool drop_empty = false;
 
 	const char* Name() const override {
 		return "ChessCompactionFilterFactory";
@@ -78,10 +101,14 @@ public:
 
 	std::unique_ptr<TERARKDB_NAMESPACE::CompactionFilter> CreateCompactionFilter(
 			const TERARKDB_NAMESPACE::CompactionFilter::Context& context) override {
-		if (!prune || !context.is_manual_compaction || context.column_family_id != 0) {
+		if (context.column_family_id != 0) {
+			return nullptr;
+		}
+		bool do_prune = prune && context.is_manual_compaction;
+		if (!do_prune && !sorted && !drop_empty) {
 			return nullptr;
 		}
-		return std::unique_ptr<TERARKDB_NAMESPACE::CompactionFilter>(new ChessCompactionFilter());
+		return std::unique_ptr<TERARKDB_NAMESPACE::CompactionFilter>(new ChessCompactionFilter(do_prune, sorted));
 	}
 };
 
@@ -2,131 +2,259 @@
 #ifndef CHESS_MERGE_H
 #define CHESS_MERGE_H
 
+#include <string.h>
 #include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "rocksdb/merge_operator.h"
 #include "ssdb.h"
 #include "ssdb_impl.h"
 #include "t_hash.h"
 
+// one bit per encoded move
+class MoveBitmap {
+	uint64_t bits[1 << 10];
+public:
+	// returns false if move is already in the set
+	bool insert(int16_t move) {
+		uint16_t m = (uint16_t)move;
+		uint64_t bit = 1ULL << (m & 63);
+		uint64_t old = bits[m >> 6];
+		bits[m >> 6] = old | bit;
+		return !(old & bit);
+	}
+	void erase(int16_t move) {
+		uint16_t m = (uint16_t)move;
+		bits[m >> 6] &= ~(1ULL << (m & 63));
+	}
+};
+
+// Operands of kv keys are native int64 deltas added to the decimal value.
+class CounterMergeOperator : public TERARKDB_NAMESPACE::MergeOperator {
+public:
+	static int64_t delta(const TERARKDB_NAMESPACE::LazyBuffer& operand) {
+		int64_t by = 0;
+		if (operand.size() == sizeof(by)) {
+			memcpy(&by, operand.data(), sizeof(by));
+		}
+		return by;
+	}
+
+	bool FullMergeV2(const MergeOperationInput& merge_in,
+		MergeOperationOutput* merge_out) const override {
+		int64_t sum = 0;
+		for (auto& item : merge_in.operand_list) {
+			if (!Fetch(item, &merge_out->new_value)) {
+				return false;
+			}
+			sum += delta(item);
+		}
+		int64_t base = 0;
+		if (merge_in.existing_value) {
+			auto& item = *merge_in.existing_value;
+			if (!Fetch(item, &merge_out->new_value)) {
+				return false;
+			}
+			base = str_to_int64(item.data(), item.size());
+			if (errno != 0) {
+				// incr on a non-integer fails, keep the value
+				merge_out->new_value.reset(item.slice(), true);
+				return true;
+			}
+		}
+		merge_out->new_value.reset(str(base + sum));
+		return true;
+	}
+
+	bool PartialMergeMulti(const TERARKDB_NAMESPACE::Slice& /*key*/,
+		const std::vector<TERARKDB_NAMESPACE::LazyBuffer>& operand_list,
+		TERARKDB_NAMESPACE::LazyBuffer* new_value, TERARKDB_NAMESPACE::Logger* /*logger*/) const override {
+		int64_t sum = 0;
+		for (auto& operand : operand_list) {
+			if (!Fetch(operand, new_value)) {
+				return false;
+			}
+			sum += delta(operand);
+		}
+		new_value->reset(std::string((const char*)&sum, sizeof(sum)));
+		return true;
+	}
+
+	const char* Name() const override {
+		return "CounterMergeOperator";
+	}
+};
+
 class ChessMergeOperator : public TERARKDB_NAMESPACE::MergeOperator {
+	// emit entries sorted by move
+	bool sorted;
+	CounterMergeOperator counters;
 public:
-	ChessMergeOperator() {}
+	ChessMergeOperator(bool sorted=false) : sorted(sorted) {}
 	
 	virtual ~ChessMergeOperator() { }
 
-	bool FullMergeV2(const MergeOperationInput& merge_in,
-		MergeOperationOutput* merge_out) const override {
-		// keep newest at front() in arr
-		std::vector<BytesPair> arr;
-		static const int kExtraLen = 4;
-		size_t len = 0;
-		// items at back() are newer ones, items at begin() will be
-		// overwritten by ones at back()
-		for (int i = merge_in.operand_list.size() - 1; i >= -1; i--) {
-			std::vector<BytesPair> exists;
-			if (i >= 0) {
-				auto& item = merge_in.operand_list[i];
-				if (!Fetch(item, &merge_out->new_value)) {
-					return false;
-				}
-				Bytes slice(item.data(), item.size());
-				if (get_hash_bytes(slice, exists) == -1) {
+	static bool isMoveList(const char* data, size_t size) {
+		return size != 0 && size % sizeof(HashEntry) == 0;
+	}
+
+	// kHashIncrTag followed by entries whose scores are deltas
+	static bool isIncrement(const char* data, size_t size) {
+		return size % sizeof(HashEntry) == 1 && data[0] == kHashIncrTag;
+	}
+
+	// Full merge of lists, newest first, that contain increment operands.
+	// An increment adds to the newest older entry of the same move, or to
+	// zero if there is none or it is a tombstone.
+	static void mergeCounters(const Bytes* lists, int n, bool sorted, std::string* out) {
+		std::unordered_map<int16_t, int32_t> pending;
+		std::unordered_set<int16_t> done;
+		std::vector<HashEntry> result;
+		for (int i = 0; i < n; i++) {
+			bool incr = isIncrement(lists[i].data(), lists[i].size());
+			const HashEntry* src = (const HashEntry*)(lists[i].data() + (incr? 1 : 0));
+			int m = lists[i].size() / sizeof(HashEntry);
+			for (int j = 0; j < m; j++) {
+				HashEntry e;
+				memcpy(&e, src + j, sizeof(e));
+				if (incr) {
+					if (done.find(e.move) == done.end()) {
+						pending[e.move] += e.score;
+					}
 					continue;
 				}
-			}
-			else if (merge_in.existing_value) {
-				if (!Fetch(*merge_in.existing_value, &merge_out->new_value)) {
-					return false;
+				if (!done.insert(e.move).second) {
+					continue;
 				}
-				if (merge_in.existing_value->empty()) {
-					break;
+				auto it = pending.find(e.move);
+				if (it != pending.end()) {
+					e.score = clamp_hash_score((e.score == 0x7FFF? 0 : e.score) + (int64_t)it->second);
+					pending.erase(it);
 				}
-				// filter existing value as well
-				Bytes slice(merge_in.existing_value->data(), merge_in.existing_value->size());
-				if (get_hash_bytes(slice, exists) == -1) {
-					continue;
+				if (e.score != 0x7FFF) {
+					result.push_back(e);
 				}
 			}
-			else {
-				break;
-			}
-			arr.reserve(arr.size() + exists.size());
-			for (auto& item : exists) {
-				auto it = std::find_if(arr.begin(), arr.end(), [&item](const BytesPair& p) {
-					return (p.first == item.first);
-				});
-				if (it == arr.end()) {
-					arr.emplace_back(item.first, item.second);
-					len += kExtraLen;
+		}
+		for (auto& item : pending) {
+			HashEntry e;
+			e.move = item.first;
+			e.score = clamp_hash_score(item.second);
+			result.push_back(e);
+		}
+		if (sorted) {
+			std::sort(result.begin(), result.end(), hash_entry_less);
+		}
+		out->assign((const char*)result.data(), result.size() * sizeof(HashEntry));
+	}
+
+	// Merges packed move lists, newest first, into out, which must have
+	// room for all of them. The newest entry of each move wins, tombstones
+	// shadow older entries and are dropped on a full merge.
+	// Returns the number of bytes written.
+	static size_t mergeMoves(const Bytes* lists, int n, bool full, bool sorted, char* out) {
+		static __thread MoveBitmap seen;
+		HashEntry* dst = (HashEntry*)out;
+		size_t count = 0;
+		for (int i = 0; i < n; i++) {
+			const HashEntry* src = (const HashEntry*)lists[i].data();
+			int m = lists[i].size() / sizeof(HashEntry);
+			for (int j = 0; j < m; j++) {
+				if (seen.insert(src[j].move) && !(full && src[j].score == 0x7FFF)) {
+					dst[count++] = src[j];
 				}
 			}
 		}
-		merge_out->new_value.clear();
-		auto builder = merge_out->new_value.get_builder();
-		builder->uninitialized_resize(len);
-		size_t pos = 0;
-		auto append = [builder, &pos, &len](const void* data, size_t size) {
-			if (size == 0) {
-				return true;
+		for (int i = 0; i < n; i++) {
+			const HashEntry* src = (const HashEntry*)lists[i].data();
+			int m = lists[i].size() / sizeof(HashEntry);
+			for (int j = 0; j < m; j++) {
+				seen.erase(src[j].move);
+			}
+		}
+		if (sorted) {
+			count = sort_hash_entries(out, count);
+		}
+		return count * sizeof(HashEntry);
+	}
+
+	bool FullMergeV2(const MergeOperationInput& merge_in,
+		MergeOperationOutput* merge_out) const override {
+		if (!merge_in.key.empty() && merge_in.key[0] == DataType::KV) {
+			return counters.FullMergeV2(merge_in, merge_out);
+		}
+		// newest first
+		std::vector<Bytes> lists;
+		lists.reserve(merge_in.operand_list.size() + 1);
+		size_t len = 0;
+		bool incr = false;
+		for (int i = merge_in.operand_list.size() - 1; i >= 0; i--) {
+			auto& item = merge_in.operand_list[i];
+			if (!Fetch(item, &merge_out->new_value)) {
+				return false;
 			}
-			size_t new_pos = pos + size;
-			if (new_pos > len) {
+			if (isMoveList(item.data(), item.size())) {
+				lists.emplace_back(item.data(), item.size());
+				len += item.size();
+			}else if (isIncrement(item.data(), item.size())) {
+				lists.emplace_back(item.data(), item.size());
+				incr = true;
+			}
+		}
+		if (merge_in.existing_value) {
+			auto& item = *merge_in.existing_value;
+			if (!Fetch(item, &merge_out->new_value)) {
 				return false;
 			}
-			memcpy(builder->data() + pos, data, size);
-			pos = new_pos;
-			return true;
-		};
-		for (auto& item : arr) {
-			if (!isDeleted(item.first, item.second)) {
-				append(item.first.data(), item.first.size());
-				append(item.second.data(), item.second.size());
+			if (isMoveList(item.data(), item.size())) {
+				lists.emplace_back(item.data(), item.size());
+				len += item.size();
 			}
 		}
+		if (incr) {
+			std::string out;
+			mergeCounters(lists.data(), lists.size(), sorted, &out);
+			merge_out->new_value.reset(std::move(out));
+			return true;
+		}
+		merge_out->new_value.clear();
+		auto builder = merge_out->new_value.get_builder();
+		builder->uninitialized_resize(len);
+		size_t pos = mergeMoves(lists.data(), lists.size(), true, sorted, builder->data());
 		builder->uninitialized_resize(pos);
 		return true;
 	}
 
-	bool isDeleted(const Bytes& field, const Bytes& value) const {
-		return (*(int16_t*)value.data() == 0x7FFF);
-	}
-
-	bool PartialMergeMulti(const TERARKDB_NAMESPACE::Slice& /*key*/,
+	bool PartialMergeMulti(const TERARKDB_NAMESPACE::Slice& key,
 		const std::vector<TERARKDB_NAMESPACE::LazyBuffer>& operand_list,
-		TERARKDB_NAMESPACE::LazyBuffer* new_value, TERARKDB_NAMESPACE::Logger* /*logger*/) const override {
-		std::vector<BytesPair> arr;
-		static const int kExtraLen = 4;
-		int len = 0;
+		TERARKDB_NAMESPACE::LazyBuffer* new_value, TERARKDB_NAMESPACE::Logger* logger) const override {
+		if (!key.empty() && key[0] == DataType::KV) {
+			return counters.PartialMergeMulti(key, operand_list, new_value, logger);
+		}
 		// operand_list is oldest to newest, iterate in reverse so newest wins
+		std::vector<Bytes> lists;
+		lists.reserve(operand_list.size());
+		size_t len = 0;
 		for (int i = operand_list.size() - 1; i >= 0; i--) {
 			auto& operand = operand_list[i];
 			if (!Fetch(operand, new_value)) {
 				return false;
 			}
-			std::vector<BytesPair> exists;
-			Bytes slice(operand.data(), operand.size());
-			if (get_hash_bytes(slice, exists) == -1) {
-				continue;
-			}
-			arr.reserve(arr.size() + exists.size());
-			for (auto& item : exists) {
-				auto it = std::find_if(arr.begin(), arr.end(), [&item](const BytesPair& p) {
-					return (p.first == item.first);
-				});
-				if (it == arr.end()) {
-					arr.emplace_back(item.first, item.second);
-					len += kExtraLen;
-				}
+			if (isMoveList(operand.data(), operand.size())) {
+				lists.emplace_back(operand.data(), operand.size());
+				len += operand.size();
+			}else if (isIncrement(operand.data(), operand.size())) {
+				// increments only fold onto a base value
+				return false;
 			}
 		}
 		std::string* str = new_value->trans_to_string();
 		str->clear();
-		str->reserve(len);
-		for (auto& item : arr) {
-			str->append(item.first.data(), item.first.size());
-			str->append(item.second.data(), item.second.size());
-		}
+		str->resize(len);
+		size_t pos = mergeMoves(lists.data(), lists.size(), false, sorted, &(*str)[0]);
+		str->resize(pos);
 		return true;
 	}
 
@@ -53,6 +53,10 @@ public:
 	static const char QPOP_BACK		= 12;
 	static const char QPOP_FRONT	= 13;
 	static const char QSET			= 14;
+	// merge operand of a hash, for slaves to apply as is
+	static const char HMERGE		= 15;
+	// CTRL, a BinlogFrame of the logs that follow
+	static const char FRAME			= 16;
 	
 	static const char BEGIN  = 7;
 	static const char END    = 8;
@@ -144,7 +144,8 @@ HIterator::HIterator(const Bytes &values,
 	uint64_t limit,
 	Iterator::Direction direction)
 {
-	if (get_hash_values(values, this->values) != -1) {
+	this->return_val_ = true;
+	if (get_hash_fields(values, this->values) != -1) {
 		if (direction == Iterator::FORWARD) {
 			std::sort(this->values.begin(), this->values.end(),
 					[](const StrPair &a, const StrPair &b) { return a.first < b.first; });
@@ -185,13 +186,21 @@ HIterator::HIterator(const Bytes &values,
 	}
 }
 
+void HIterator::return_val(bool onoff) {
+	this->return_val_ = onoff;
+}
+
 bool HIterator::next() {
 	if (index >= values.size() || index >= limit) {
 		return false;
 	}
 	else {
+		const std::string &entry = values[index].second;
 		key = values[index].first;
-		val = values[index].second;
+		packed = Bytes(entry.data(), entry.size());
+		if (return_val_) {
+			val = str(*(const int16_t *)(entry.data() + sizeof(int16_t)));
+		}
 		index++;
 		return true;
 	}
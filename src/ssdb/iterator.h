@@ -64,16 +64,21 @@ class HIterator{
 public:
 	std::string key;
 	std::string val;
+	// the packed (int16 move, int16 score) entry of key
+	Bytes packed;
 
 	HIterator(const Bytes &values,
 			const std::string &start,
 			const std::string &end,
 			uint64_t limit,
 			Iterator::Direction direction=Iterator::FORWARD);
+	void return_val(bool onoff);
 	bool next();
 private:
 	size_t index;
 	uint64_t limit;
+	bool return_val_;
+	// field => packed entry
 	std::vector<StrPair> values;
 };
 
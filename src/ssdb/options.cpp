@@ -24,7 +24,16 @@ void Options::load(const Config &conf){
 	std::string compression_str = conf.get_str("rocksdb.compression");
 	std::string binlog_str = conf.get_str("replication.binlog");
 	binlog_capacity = (size_t)conf.get_num("replication.binlog.capacity");
+	binlog_wal_ttl = (uint64_t)conf.get_num("replication.binlog.wal_ttl");
+	binlog_wal_size = (uint64_t)conf.get_num("replication.binlog.wal_size");
+	std::string binlog_delta_str = conf.get_str("replication.delta");
 	std::string wal_str = conf.get_str("rocksdb.wal");
+	std::string group_commit_str = conf.get_str("rocksdb.group_commit");
+	std::string merge_counters_str = conf.get_str("rocksdb.merge_counters");
+	std::string hash_sorted_str = conf.get_str("hash.sorted");
+	hash_canonical = conf.get_str("hash.canonical");
+	hash_cache_size = (size_t)conf.get_num("hash.cache_size");
+	std::string hash_blind_delete_str = conf.get_str("hash.blind_delete");
 
 	strtolower(&compression_str);
 	if(compression_str != "no"){
@@ -33,20 +42,59 @@ void Options::load(const Config &conf){
 		compression = false;
 	}
 	strtolower(&binlog_str);
-	if(binlog_str != "yes"){
+	binlog_wal = false;
+	if(binlog_str == "wal"){
+		binlog = true;
+		binlog_wal = true;
+	}else if(binlog_str != "yes"){
 		binlog = false;
 	}else{
 		binlog = true;
 	}
+	strtolower(&binlog_delta_str);
+	if(binlog_delta_str != "yes"){
+		binlog_delta = false;
+	}else{
+		binlog_delta = true;
+	}
 	strtolower(&wal_str);
 	if(wal_str != "no"){
 		wal = true;
 	}else{
 		wal = false;
 	}
+	strtolower(&merge_counters_str);
+	if(merge_counters_str != "yes"){
+		merge_counters = false;
+	}else{
+		merge_counters = true;
+	}
+	strtolower(&hash_sorted_str);
+	if(hash_sorted_str != "yes"){
+		hash_sorted = false;
+	}else{
+		hash_sorted = true;
+	}
+	strtolower(&hash_canonical);
+	strtolower(&hash_blind_delete_str);
+	if(hash_blind_delete_str == "yes"){
+		hash_blind_delete = 1;
+	}else if(hash_blind_delete_str == "count"){
+		hash_blind_delete = 2;
+	}else{
+		hash_blind_delete = 0;
+	}
+	if(group_commit_str.empty()){
+		group_commit = 64;
+	}else{
+		group_commit = (size_t)str_to_int(group_commit_str);
+	}
 	if(binlog_capacity <= 0){
 		binlog_capacity = LOG_QUEUE_SIZE;
 	}
+	if(binlog_wal && binlog_wal_ttl == 0 && binlog_wal_size == 0){
+		binlog_wal_ttl = 24 * 3600;
+	}
 
 	if(write_buffer_size <= 0){
 		write_buffer_size = 1024;
@@ -22,7 +22,22 @@ public:
 	bool compression;
 	bool binlog;
 	size_t binlog_capacity;
+	// binlog: wal, replicate from the engine WAL instead of oplogCF
+	bool binlog_wal;
+	uint64_t binlog_wal_ttl;
+	uint64_t binlog_wal_size;
+	// hash merges are replicated as HMERGE operands instead of full values
+	bool binlog_delta;
 	bool wal;
+	// KB, 0 disables group commit
+	size_t group_commit;
+	bool merge_counters;
+	bool hash_sorted;
+	std::string hash_canonical;
+	// MB, 0 disables the value cache
+	size_t hash_cache_size;
+	// 0: read-modify-write hdel, 1: blind hdel, 2: blind hdel returning a count
+	int hash_blind_delete;
 };
 
 #endif
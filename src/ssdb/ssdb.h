@@ -35,6 +35,7 @@ public:
 	virtual std::vector<std::string> info() = 0;
 	virtual void compact(int flag) = 0;
 	virtual int key_range(std::vector<std::string> *keys) = 0;
+	virtual int checkpoint(std::string *dir, uint64_t *seq) = 0;
 
 	/* raw operates */
 
@@ -48,7 +49,8 @@ public:
 	virtual int set(const Bytes &key, const Bytes &val, char log_type=BinlogType::SYNC) = 0;
 	virtual int setnx(const Bytes &key, const Bytes &val, char log_type=BinlogType::SYNC) = 0;
 	virtual int del(const Bytes &key, char log_type=BinlogType::SYNC) = 0;
-	// -1: error, 1: ok, 0: value is not an integer or out of range
+	// -1: error, 1: ok, 0: value is not an integer or out of range,
+	// with merge_counters new_val is by, the value is not read
 	virtual int incr(const Bytes &key, int64_t by, int64_t *new_val, char log_type=BinlogType::SYNC) = 0;
 	virtual int multi_set(const std::vector<Bytes> &kvs, int offset=0, char log_type=BinlogType::SYNC) = 0;
 	virtual int multi_del(const std::vector<Bytes> &keys, int offset=0, char log_type=BinlogType::SYNC) = 0;
@@ -72,9 +74,11 @@ public:
 	virtual int migrate_hset(const std::vector<Bytes>& items, int offset, char log_type=BinlogType::SYNC) = 0;
 	virtual int sync_hset(const Bytes &name, const Bytes &val, char log_type=BinlogType::SYNC) = 0;
 	virtual int sync_hdel(const Bytes &name, char log_type=BinlogType::SYNC) = 0;
+	virtual int sync_hmerge(const Bytes &name, const Bytes &val, char log_type=BinlogType::SYNC) = 0;
 	virtual int hset(const Bytes &name, const Bytes &key, const Bytes &val, char log_type=BinlogType::SYNC) = 0;
 	virtual int hdel(const Bytes &name, const Bytes &key, char log_type=BinlogType::SYNC) = 0;
-	// -1: error, 1: ok, 0: value is not an integer or out of range
+	// -1: error, 1: ok, 0: value is not an integer or out of range,
+	// with merge_counters new_val is by, the value is not read
 	virtual int hincr(const Bytes &name, const Bytes &key, int64_t by, int64_t *new_val, char log_type=BinlogType::SYNC) = 0;
 	virtual int multi_hset(const Bytes &name, const std::vector<Bytes> &kvs, int offset=0, char log_type=BinlogType::SYNC) = 0;
 	virtual int multi_hdel(const Bytes &name, const std::vector<Bytes> &keys, int offset=0, char log_type=BinlogType::SYNC) = 0;
@@ -84,6 +88,19 @@ public:
 	virtual int hget(const Bytes &name, const Bytes &key, std::string *val) = 0;
 	virtual int multi_hget(const Bytes &name, const std::vector<Bytes> &keys, int offset, std::vector<std::string> &vals) = 0;
 	virtual int hgetall(const Bytes &name, std::vector<StrPair>& vals) = 0;
+	// packed (int16 move, int16 score) entries, without formatting
+	virtual int hgetall_packed(const Bytes &name, std::string *packed) = 0;
+	virtual int multi_hget_packed(const Bytes &name, const std::vector<Bytes> &keys, int offset, std::string *packed) = 0;
+	// many hashes in one batched lookup, missing ones are skipped.
+	// list: name, size, key, val, ...
+	virtual int multi_hgetall(const std::vector<Bytes> &names, int offset, std::vector<std::string> *list) = 0;
+	// list: name, packed entries, ...
+	virtual int multi_hgetall_packed(const std::vector<Bytes> &names, int offset, std::vector<std::string> *list) = 0;
+	// sizes of many hashes in one batched lookup, 0 for missing ones
+	virtual int multi_hsize(const std::vector<Bytes> &names, int offset, std::vector<int64_t> *sizes) = 0;
+	// moves ordered by score, best first, at most limit of them(0: no limit),
+	// and only those within margin of the best one if margin >= 0
+	virtual int hbest(const Bytes &name, int limit, int margin, std::vector<StrPair>& vals) = 0;
 	virtual int hlist(const Bytes &name_s, const Bytes &name_e, uint64_t limit,
 			std::vector<std::string> *list) = 0;
 	virtual int hrlist(const Bytes &name_s, const Bytes &name_e, uint64_t limit,
@@ -10,6 +10,7 @@ found in the LICENSE file.
 #include "rocksdb/cache.h"
 #include "rocksdb/filter_policy.h"
 #include "rocksdb/table.h"
+#include "rocksdb/utilities/checkpoint.h"
 #include "chess_merge.h"
 #include "chess_filter.h"
 #include <table/terark_zip_table.h>
@@ -19,16 +20,31 @@ found in the LICENSE file.
 #include "t_hash.h"
 #include "t_zset.h"
 #include "t_queue.h"
+#include "../util/file.h"
+
+static const std::string kOplogCF = "oplogCF";
 
 SSDBImpl::SSDBImpl(){
 	ldb = NULL;
 	binlogs = NULL;
+	canonicalizer = NULL;
+	cache = NULL;
+	blind_delete = 0;
+	merge_counters = false;
+	hash_sorted = false;
+	delta_binlog = false;
 }
 
 SSDBImpl::~SSDBImpl(){
 	if(binlogs){
 		delete binlogs;
 	}
+	if(canonicalizer){
+		delete canonicalizer;
+	}
+	if(cache){
+		delete cache;
+	}
 	if(ldb){
 		for (int i = 0; i < cfHandles.size(); i++) {
 			ldb->DestroyColumnFamilyHandle(cfHandles[i]);
@@ -39,14 +55,18 @@ SSDBImpl::~SSDBImpl(){
 
 SSDB* SSDB::open(const Options &opt, const std::string &dir){
 	SSDBImpl *ssdb = new SSDBImpl();
+	ssdb->dir = dir;
 	ssdb->options.create_if_missing = true;
 	ssdb->options.create_missing_column_families = true;
 	ssdb->options.IncreaseParallelism();
 	ssdb->options.OptimizeUniversalStyleCompaction(1024ULL * 1024 * 4 * opt.write_buffer_size);
 	ssdb->options.max_open_files = opt.max_open_files;
 	ssdb->options.target_file_size_base = 1024ULL * 1024 * opt.sst_size;
-	ssdb->options.merge_operator.reset(new ChessMergeOperator());
-	ssdb->options.compaction_filter_factory.reset(new ChessCompactionFilterFactory());
+	ssdb->options.merge_operator.reset(new ChessMergeOperator(opt.hash_sorted));
+	ChessCompactionFilterFactory *filter_factory = new ChessCompactionFilterFactory();
+	filter_factory->sorted = opt.hash_sorted;
+	filter_factory->drop_empty = opt.hash_blind_delete != 0;
+	ssdb->options.compaction_filter_factory.reset(filter_factory);
 	ssdb->options.memtable_factory.reset(TERARKDB_NAMESPACE::NewPatriciaTrieRepFactory());
 	ssdb->options.enable_pipelined_write = true;
 	ssdb->options.stats_dump_period_sec = 0;
@@ -66,8 +86,20 @@ SSDB* SSDB::open(const Options &opt, const std::string &dir){
 		ssdb->options.compression = TERARKDB_NAMESPACE::kNoCompression;
 	}
 	ssdb->write_opts.disableWAL = !opt.wal;
+	if(opt.binlog_wal){
+		// archived WAL files are the binlogs slaves sync from
+		ssdb->options.WAL_ttl_seconds = opt.binlog_wal_ttl;
+		ssdb->options.WAL_size_limit_MB = opt.binlog_wal_size;
+	}
+	ssdb->canonicalizer = NameCanonicalizer::create(opt.hash_canonical);
+	ssdb->blind_delete = opt.hash_blind_delete;
+	ssdb->merge_counters = opt.merge_counters;
+	ssdb->hash_sorted = opt.hash_sorted;
+	ssdb->delta_binlog = opt.binlog_delta;
+	if(ssdb->canonicalizer){
+		log_info("hash names canonicalized by %s", ssdb->canonicalizer->name());
+	}
 
-	static const std::string kOplogCF = "oplogCF";
 	TERARKDB_NAMESPACE::ColumnFamilyOptions oplogOptions;
 	oplogOptions.OptimizeUniversalStyleCompaction();
 	std::vector<TERARKDB_NAMESPACE::ColumnFamilyDescriptor> cfDescriptors = {
@@ -79,7 +111,12 @@ SSDB* SSDB::open(const Options &opt, const std::string &dir){
 		log_error("open db failed: %s", status.ToString().c_str());
 		goto err;
 	}
-	ssdb->binlogs = new BinlogQueue(ssdb->ldb, ssdb->cfHandles, opt.binlog, opt.binlog_capacity, opt.wal);
+	ssdb->binlogs = new BinlogQueue(ssdb->ldb, ssdb->cfHandles, opt.binlog, opt.binlog_capacity, opt.wal, opt.binlog_wal);
+	ssdb->binlogs->set_group_size(opt.group_commit * 1024);
+	if(opt.hash_cache_size > 0){
+		ssdb->cache = new ValueCache(1024ULL * 1024 * opt.hash_cache_size);
+		ssdb->binlogs->set_cache(ssdb->cache);
+	}
 
 	return ssdb;
 err:
@@ -99,6 +136,9 @@ int SSDBImpl::flushdb(){
 		ret = -1;
 	}
 	binlogs->flush();
+	if(cache){
+		cache->clear();
+	}
 	return ret;
 }
 
@@ -114,6 +154,9 @@ Iterator* SSDBImpl::rev_iterator(const std::string &start, const std::string &en
 
 int SSDBImpl::raw_set(const Bytes &key, const Bytes &val){
 	TERARKDB_NAMESPACE::Status s = ldb->Put(write_opts, slice(key), slice(val));
+	if(cache){
+		cache->erase(key.String());
+	}
 	if(!s.ok()){
 		log_error("set error: %s", s.ToString().c_str());
 		return -1;
@@ -123,6 +166,9 @@ int SSDBImpl::raw_set(const Bytes &key, const Bytes &val){
 
 int SSDBImpl::raw_del(const Bytes &key){
 	TERARKDB_NAMESPACE::Status s = ldb->Delete(write_opts, slice(key));
+	if(cache){
+		cache->erase(key.String());
+	}
 	if(!s.ok()){
 		log_error("del error: %s", s.ToString().c_str());
 		return -1;
@@ -189,6 +235,10 @@ void SSDBImpl::compact(int flag){
 		opts.exclusive_manual_compaction = false;
 		ldb->CompactRange(opts, nullptr, nullptr);
 		factory->prune = false;
+		// pruned values differ from what was cached
+		if(cache){
+			cache->clear();
+		}
 	}else if(flag == 1){
 		TERARKDB_NAMESPACE::CompactRangeOptions opts;
 		opts.exclusive_manual_compaction = false;
@@ -215,3 +265,54 @@ int SSDBImpl::key_range(std::vector<std::string> *keys){
 	}
 	return 0;
 }
+
+// the seq of the last oplog entry of the db in dir
+static int last_oplog_seq(const TERARKDB_NAMESPACE::Options &options, const std::string &dir, uint64_t *seq){
+	std::vector<TERARKDB_NAMESPACE::ColumnFamilyDescriptor> cfDescriptors = {
+		TERARKDB_NAMESPACE::ColumnFamilyDescriptor(TERARKDB_NAMESPACE::kDefaultColumnFamilyName, options),
+		TERARKDB_NAMESPACE::ColumnFamilyDescriptor(kOplogCF, TERARKDB_NAMESPACE::ColumnFamilyOptions())
+	};
+	std::vector<TERARKDB_NAMESPACE::ColumnFamilyHandle*> handles;
+	TERARKDB_NAMESPACE::DB *db = NULL;
+	TERARKDB_NAMESPACE::Status s = TERARKDB_NAMESPACE::DB::OpenForReadOnly(options, dir, cfDescriptors, &handles, &db);
+	if(!s.ok()){
+		log_error("open checkpoint error: %s", s.ToString().c_str());
+		return -1;
+	}
+	Binlog log;
+	int ret = BinlogQueue::find_last(db, handles[kOplogCFHandle], &log);
+	*seq = (ret == 1)? log.seq() : 0;
+	for(int i = 0; i < handles.size(); i++){
+		db->DestroyColumnFamilyHandle(handles[i]);
+	}
+	delete db;
+	return ret == -1? -1 : 0;
+}
+
+int SSDBImpl::checkpoint(std::string *dir, uint64_t *seq){
+	TERARKDB_NAMESPACE::Checkpoint *cp = NULL;
+	TERARKDB_NAMESPACE::Status s = TERARKDB_NAMESPACE::Checkpoint::Create(ldb, &cp);
+	if(!s.ok()){
+		log_error("checkpoint error: %s", s.ToString().c_str());
+		return -1;
+	}
+	uint64_t db_seq = 0;
+	*dir = this->dir + ".checkpoint." + str(time_ms());
+	s = cp->CreateCheckpoint(*dir, 0, &db_seq);
+	delete cp;
+	if(!s.ok()){
+		log_error("checkpoint error: %s", s.ToString().c_str());
+		return -1;
+	}
+	if(binlogs->is_wal()){
+		*seq = db_seq;
+		return 0;
+	}
+	// logs are committed with their writes, the last one in the
+	// checkpoint is where its data ends
+	if(last_oplog_seq(this->options, *dir, seq) == -1){
+		remove_dir(*dir);
+		return -1;
+	}
+	return 0;
+}
@@ -14,6 +14,7 @@ found in the LICENSE file.
 
 #include "ssdb.h"
 #include "binlog.h"
+#include "canonical.h"
 #include "iterator.h"
 #include "t_kv.h"
 #include "t_hash.h"
@@ -29,13 +30,33 @@ private:
 	std::vector<TERARKDB_NAMESPACE::ColumnFamilyHandle*> cfHandles;
 	TERARKDB_NAMESPACE::ReadOptions read_opts;
 	TERARKDB_NAMESPACE::WriteOptions write_opts;
+	NameCanonicalizer *canonicalizer;
+	std::string dir;
 
 	SSDBImpl();
 public:
 	BinlogQueue *binlogs;
+	// resolved hash values, NULL if disabled
+	ValueCache *cache;
+	// Options::hash_blind_delete
+	int blind_delete;
+	// incr/hincr write merge operands
+	bool merge_counters;
+	// Options::hash_sorted
+	bool hash_sorted;
+	// Options::binlog_delta
+	bool delta_binlog;
 	
 	virtual ~SSDBImpl();
 
+	// storage key of hash name, returns true if its moves are stored mirrored
+	bool hash_key(const Bytes &name, std::string *hkey);
+	bool canonical_names() const{
+		return canonicalizer != NULL;
+	}
+	// logs a merge of operand into hkey, within a transaction
+	void log_hash_merge(const Bytes &hkey, const Bytes &operand, char log_type);
+
 	virtual int flushdb();
 
 	// return (start, end], not include start
@@ -46,6 +67,9 @@ public:
 	virtual std::vector<std::string> info();
 	virtual void compact(int flag);
 	virtual int key_range(std::vector<std::string> *keys);
+	// hard links the db into a new *dir next to it, *seq is the binlog
+	// seq a slave installing it syncs after
+	virtual int checkpoint(std::string *dir, uint64_t *seq);
 	
 	/* raw operates */
 
@@ -76,6 +100,7 @@ public:
 	virtual int migrate_hset(const std::vector<Bytes>& items, int offset, char log_type=BinlogType::SYNC);
 	virtual int sync_hset(const Bytes &name, const Bytes &val, char log_type=BinlogType::SYNC);
 	virtual int sync_hdel(const Bytes &name, char log_type=BinlogType::SYNC);
+	virtual int sync_hmerge(const Bytes &name, const Bytes &val, char log_type=BinlogType::SYNC);
 	virtual int hset(const Bytes &name, const Bytes &key, const Bytes &val, char log_type=BinlogType::SYNC);
 	virtual int hdel(const Bytes &name, const Bytes &key, char log_type=BinlogType::SYNC);
 	// -1: error, 1: ok, 0: value is not an integer or out of range
@@ -88,6 +113,12 @@ public:
 	virtual int hget(const Bytes &name, const Bytes &key, std::string *val);
 	virtual int multi_hget(const Bytes &name, const std::vector<Bytes> &keys, int offset, std::vector<std::string> &vals);
 	virtual int hgetall(const Bytes &name, std::vector<StrPair>& vals);
+	virtual int hgetall_packed(const Bytes &name, std::string *packed);
+	virtual int multi_hget_packed(const Bytes &name, const std::vector<Bytes> &keys, int offset, std::string *packed);
+	virtual int multi_hgetall(const std::vector<Bytes> &names, int offset, std::vector<std::string> *list);
+	virtual int multi_hgetall_packed(const std::vector<Bytes> &names, int offset, std::vector<std::string> *list);
+	virtual int multi_hsize(const std::vector<Bytes> &names, int offset, std::vector<int64_t> *sizes);
+	virtual int hbest(const Bytes &name, int limit, int margin, std::vector<StrPair>& vals);
 	virtual int hlist(const Bytes &name_s, const Bytes &name_e, uint64_t limit,
 			std::vector<std::string> *list);
 	virtual int hrlist(const Bytes &name_s, const Bytes &name_e, uint64_t limit,
@@ -150,6 +181,12 @@ public:
 	virtual int qset_by_seq(const Bytes &name, uint64_t seq, const Bytes &item, char log_type=BinlogType::SYNC);
 
 private:
+	// value of hash name with moves as seen from name
+	// -1: error, 0: not found, 1: found
+	int hash_value(const Bytes &name, std::string *value);
+	// values of names[offset..], empty for missing ones
+	int multi_hget_values(const std::vector<Bytes> &names, int offset, std::vector<std::string> *values);
+	int hdel_blind(const Bytes &name, const std::vector<Bytes> &keys, int offset, char log_type);
 	int64_t _qpush(const Bytes &name, const Bytes &item, uint64_t front_or_back_seq, char log_type=BinlogType::SYNC);
 	int _qpop(const Bytes &name, std::string *item, uint64_t front_or_back_seq, char log_type=BinlogType::SYNC);
 };
@@ -5,6 +5,7 @@ found in the LICENSE file.
 */
 #include "t_hash.h"
 #include "rocksdb/utilities/write_batch_with_index.h"
+#include <unordered_map>
 
 static int hset_one(SSDBImpl *ssdb, const Bytes &name, const Bytes &key, const Bytes &val, char log_type);
 
@@ -18,7 +19,8 @@ int SSDBImpl::multi_hset(const Bytes &name, const std::vector<Bytes> &kvs, int o
 		return -1;
 	}
 
-	std::string hkey = encode_hash_name(name);
+	std::string hkey;
+	bool mirrored = hash_key(name, &hkey);
 	std::vector<Bytes>::const_iterator it;
 	std::string new_value;
 	new_value.reserve((kvs.size() - offset) * 2);
@@ -34,12 +36,16 @@ int SSDBImpl::multi_hset(const Bytes &name, const std::vector<Bytes> &kvs, int o
 			return -1;
 		}
 		const Bytes &val = *(it + 1);
-		new_value.append(encode_hash_value(key, val));
+		if(mirrored){
+			new_value.append(encode_hash_value(mirror_hash_field(key), val));
+		}else{
+			new_value.append(encode_hash_value(key, val));
+		}
 	}
 	if (!new_value.empty()) {
 		Transaction trans(binlogs);
 		binlogs->Merge(hkey, slice(new_value));
-		binlogs->add_log(log_type, BinlogCommand::HSET, hkey);
+		log_hash_merge(hkey, new_value, log_type);
 		TERARKDB_NAMESPACE::Status s = binlogs->commit();
 		if(!s.ok()){
 			log_error("multi_hset error: %s", s.ToString().c_str());
@@ -59,8 +65,12 @@ int SSDBImpl::multi_hdel(const Bytes &name, const std::vector<Bytes> &keys, int
 		log_error("name too long! %s", hexmem(name.data(), name.size()).c_str());
 		return -1;
 	}
+	if(blind_delete){
+		return hdel_blind(name, keys, offset, log_type);
+	}
 
-	std::string hkey = encode_hash_name(name);
+	std::string hkey;
+	bool mirrored = hash_key(name, &hkey);
 	std::vector<Bytes>::const_iterator it;
 	std::string new_value;
 	new_value.reserve((keys.size() - offset) * 4);
@@ -75,7 +85,11 @@ int SSDBImpl::multi_hdel(const Bytes &name, const std::vector<Bytes> &keys, int
 			log_error("key too long! %s", hexmem(key.data(), key.size()).c_str());
 			return -1;
 		}
-		new_value.append(encode_hash_value(key, kDelTag));
+		if(mirrored){
+			new_value.append(encode_hash_value(mirror_hash_field(key), kDelTag));
+		}else{
+			new_value.append(encode_hash_value(key, kDelTag));
+		}
 	}
 	if(!new_value.empty()) {
 		TERARKDB_NAMESPACE::LazyBuffer current;
@@ -123,6 +137,22 @@ int SSDBImpl::sync_hset(const Bytes &name, const Bytes &val, char log_type){
 	return 0;
 }
 
+int SSDBImpl::sync_hmerge(const Bytes &name, const Bytes &val, char log_type){
+	if(name.empty() || val.size() % sizeof(HashEntry) != 0){
+		log_error("bad hmerge: %s", hexmem(name.data(), name.size()).c_str());
+		return 0;
+	}
+	Transaction trans(binlogs);
+	binlogs->Merge(slice(name), slice(val));
+	log_hash_merge(name, val, log_type);
+	TERARKDB_NAMESPACE::Status s = binlogs->commit();
+	if(!s.ok()){
+		log_error("sync_hmerge error: %s", s.ToString().c_str());
+		return -1;
+	}
+	return 0;
+}
+
 int SSDBImpl::sync_hdel(const Bytes &name, char log_type){
 	Transaction trans(binlogs);
 	binlogs->Delete(slice(name));
@@ -135,6 +165,104 @@ int SSDBImpl::sync_hdel(const Bytes &name, char log_type){
 	return 0;
 }
 
+bool SSDBImpl::hash_key(const Bytes &name, std::string *hkey){
+	if(!canonicalizer){
+		*hkey = encode_hash_name(name);
+		return false;
+	}
+	std::string canonical;
+	bool mirrored = canonicalizer->canonicalize(name, &canonical);
+	*hkey = encode_hash_name(canonical);
+	return mirrored;
+}
+
+void SSDBImpl::log_hash_merge(const Bytes &hkey, const Bytes &operand, char log_type){
+	if(delta_binlog){
+		binlogs->add_log(log_type, BinlogCommand::HMERGE, slice(hkey), slice(operand));
+	}else{
+		binlogs->add_log(log_type, BinlogCommand::HSET, slice(hkey));
+	}
+}
+
+int SSDBImpl::hash_value(const Bytes &name, std::string *value){
+	std::string dbkey;
+	bool mirrored = hash_key(name, &dbkey);
+	uint64_t gen = 0;
+	if(!cache || !cache->get(dbkey, value, &gen)){
+		TERARKDB_NAMESPACE::Status s = ldb->Get(read_opts, dbkey, value);
+		if(s.IsNotFound()){
+			return 0;
+		}else if(!s.ok()){
+			log_error("%s", s.ToString().c_str());
+			return -1;
+		}
+		if(cache){
+			cache->put(dbkey, *value, gen);
+		}
+	}
+	if(value->empty()){
+		// all moves deleted by blind hdel
+		return 0;
+	}
+	if(mirrored){
+		mirror_hash_entries(value);
+	}
+	return 1;
+}
+
+int SSDBImpl::hdel_blind(const Bytes &name, const std::vector<Bytes> &keys, int offset, char log_type){
+	std::string hkey;
+	bool mirrored = hash_key(name, &hkey);
+	std::string new_value;
+	new_value.reserve((keys.size() - offset) * 4);
+	for(int i = offset; i < keys.size(); i++){
+		const Bytes &key = keys[i];
+		if(key.empty()){
+			log_error("empty key!");
+			return -1;
+		}
+		if(key.size() > SSDB_KEY_LEN_MAX){
+			log_error("key too long! %s", hexmem(key.data(), key.size()).c_str());
+			return -1;
+		}
+		if(mirrored){
+			new_value.append(encode_hash_value(mirror_hash_field(key), kDelTag));
+		}else{
+			new_value.append(encode_hash_value(key, kDelTag));
+		}
+	}
+	if(new_value.empty()){
+		return 0;
+	}
+	int count = new_value.size() / 4;
+	if(blind_delete == 2){
+		// not locked, a concurrent hset/hdel may change the actual count
+		std::string current;
+		int ret = hash_value(name, &current);
+		if(ret == -1){
+			return -1;
+		}
+		count = 0;
+		if(ret == 1){
+			bool sorted = hash_value_sorted(current.data(), current.size() / 4);
+			for(int i = offset; i < keys.size(); i++){
+				if(get_hash_value(current, keys[i], NULL, sorted) == 1){
+					count ++;
+				}
+			}
+		}
+	}
+	Transaction trans(binlogs);
+	binlogs->Merge(hkey, slice(new_value));
+	log_hash_merge(hkey, new_value, log_type);
+	TERARKDB_NAMESPACE::Status s = binlogs->commit();
+	if(!s.ok()){
+		log_error("hdel error: %s", s.ToString().c_str());
+		return -1;
+	}
+	return count;
+}
+
 /**
  * @return -1: error, 0: item updated, 1: new item inserted
  */
@@ -151,9 +279,18 @@ int SSDBImpl::hdel(const Bytes &name, const Bytes &key, char log_type){
 		log_error("key too long! %s", hexmem(key.data(), key.size()).c_str());
 		return -1;
 	}
+	if(blind_delete){
+		std::vector<Bytes> keys(1, key);
+		return hdel_blind(name, keys, 0, log_type);
+	}
 
-	std::string hkey = encode_hash_name(name);
-	std::string new_value = encode_hash_value(key, kDelTag);
+	std::string hkey;
+	std::string new_value;
+	if(hash_key(name, &hkey)){
+		new_value = encode_hash_value(mirror_hash_field(key), kDelTag);
+	}else{
+		new_value = encode_hash_value(key, kDelTag);
+	}
 	if(!new_value.empty()) {
 		TERARKDB_NAMESPACE::LazyBuffer current;
 		TERARKDB_NAMESPACE::Status s = ldb->Get(read_opts, hkey, &current);
@@ -189,6 +326,30 @@ int SSDBImpl::hdel(const Bytes &name, const Bytes &key, char log_type){
 }
 
 int SSDBImpl::hincr(const Bytes &name, const Bytes &key, int64_t by, int64_t *new_val, char log_type){
+	if(merge_counters){
+		std::string hkey;
+		std::string new_value;
+		if(hash_key(name, &hkey)){
+			new_value = encode_hash_incr(mirror_hash_field(key), by);
+		}else{
+			new_value = encode_hash_incr(key, by);
+		}
+		if(new_value.empty()){
+			return 0;
+		}
+		Transaction trans(binlogs);
+		binlogs->Merge(hkey, slice(new_value));
+		// not as HMERGE, a slave may apply a log twice and increments
+		// are not idempotent
+		binlogs->add_log(log_type, BinlogCommand::HSET, hkey);
+		TERARKDB_NAMESPACE::Status s = binlogs->commit();
+		if(!s.ok()){
+			log_error("hincr error: %s", s.ToString().c_str());
+			return -1;
+		}
+		*new_val = by;
+		return 1;
+	}
 	std::string old;
 	int ret = this->hget(name, key, &old);
 	if(ret == -1){
@@ -208,14 +369,47 @@ int SSDBImpl::hincr(const Bytes &name, const Bytes &key, int64_t by, int64_t *ne
 }
 
 int SSDBImpl::migrate_hset(const std::vector<Bytes>& items, int offset, char log_type) {
-	Transaction trans(binlogs);
+	// one operand per position, in order of first appearance
+	std::vector<std::pair<std::string, std::string>> positions;
+	std::unordered_map<std::string, int> index;
 	for (int i = offset; i < items.size(); i += 3) {
-		std::string hkey = encode_hash_name(items[i]);
-		Buffer new_value(4);
-		new_value.append(items[i + 1]);
-		new_value.append(items[i + 2]);
-		binlogs->Merge(hkey, TERARKDB_NAMESPACE::Slice(new_value.data(), new_value.size()));
-		binlogs->add_log(log_type, BinlogCommand::HSET, hkey);
+		if (items[i + 1].size() != sizeof(int16_t) || items[i + 2].size() != sizeof(int16_t)) {
+			log_error("bad migrate_hset item: %s", hexmem(items[i].data(), items[i].size()).c_str());
+			return -1;
+		}
+		std::string hkey;
+		bool mirrored = hash_key(items[i], &hkey);
+		HashEntry e;
+		memcpy(&e.move, items[i + 1].data(), sizeof(int16_t));
+		memcpy(&e.score, items[i + 2].data(), sizeof(int16_t));
+		if (mirrored) {
+			e.move = mirror_hash_key(e.move);
+		}
+		auto it = index.find(hkey);
+		if (it == index.end()) {
+			it = index.emplace(hkey, (int)positions.size()).first;
+			positions.emplace_back(hkey, std::string());
+		}
+		std::string &value = positions[it->second].second;
+		// later items win
+		int j = find_hash_entry(value.data(), value.size() / sizeof(HashEntry), e.move, false);
+		if (j == -1) {
+			value.append((const char *)&e, sizeof(e));
+		} else {
+			memcpy(&value[j * sizeof(HashEntry)], &e, sizeof(e));
+		}
+	}
+	if (hash_sorted) {
+		for (auto &item : positions) {
+			int n = sort_hash_entries(&item.second[0], item.second.size() / sizeof(HashEntry));
+			item.second.resize(n * sizeof(HashEntry));
+		}
+	}
+
+	Transaction trans(binlogs);
+	for (auto &item : positions) {
+		binlogs->Merge(item.first, slice(item.second));
+		log_hash_merge(item.first, item.second, log_type);
 	}
 	TERARKDB_NAMESPACE::Status s = binlogs->commit();
 	if (!s.ok()) {
@@ -225,39 +419,32 @@ int SSDBImpl::migrate_hset(const std::vector<Bytes>& items, int offset, char log
 }
 
 int SSDBImpl::multi_hget(const Bytes &name, const std::vector<Bytes> &keys, int offset, std::vector<std::string> &vals){
-	std::string dbkey = encode_hash_name(name);
-	TERARKDB_NAMESPACE::LazyBuffer value;
-	TERARKDB_NAMESPACE::Status s = ldb->Get(read_opts, dbkey, &value);
-	if(s.IsNotFound()){
-		return 0;
-	}else if(!s.ok()){
-		return -1;
+	std::string value;
+	int ret = hash_value(name, &value);
+	if(ret <= 0){
+		return ret;
 	}
 	int n = keys.size() - offset;
 	vals.resize(n);
+	bool sorted = n > 1 && hash_value_sorted(value.data(), value.size() / (2 * sizeof(int16_t)));
 	for(int i = 0; i < n; i++){
-		get_hash_value(Bytes(value.data(), value.size()), keys[offset + i], &vals[i]);
+		get_hash_value(Bytes(value.data(), value.size()), keys[offset + i], &vals[i], sorted);
 	}
 	return 0;
 }
 
 int64_t SSDBImpl::hsize(const Bytes &name){
-	std::string dbkey = encode_hash_name(name);
-	TERARKDB_NAMESPACE::LazyBuffer val;
-	TERARKDB_NAMESPACE::Status s;
-
-	s = ldb->Get(read_opts, dbkey, &val);
-	if(s.IsNotFound()){
-		return 0;
-	}else if(!s.ok()){
-		return -1;
-	}else{
-		return get_hash_value_count(Bytes(val.data(), val.size()));
+	std::string val;
+	int ret = hash_value(name, &val);
+	if(ret <= 0){
+		return ret;
 	}
+	return get_hash_value_count(val);
 }
 
 int64_t SSDBImpl::hclear(const Bytes &name, char log_type){
-	std::string hkey = encode_hash_name(name);
+	std::string hkey;
+	hash_key(name, &hkey);
 	Transaction trans(binlogs);
 	binlogs->Delete(hkey);
 	binlogs->add_log(log_type, BinlogCommand::HDEL, hkey);
@@ -269,58 +456,175 @@ int64_t SSDBImpl::hclear(const Bytes &name, char log_type){
 }
 
 int SSDBImpl::hget(const Bytes &name, const Bytes &key, std::string *val){
-	std::string dbkey = encode_hash_name(name);
-	TERARKDB_NAMESPACE::LazyBuffer value;
-	TERARKDB_NAMESPACE::Status s = ldb->Get(read_opts, dbkey, &value);
-	if(s.IsNotFound()){
-		return 0;
-	}else if(!s.ok()){
-		log_error("%s", s.ToString().c_str());
-		return -1;
+	std::string value;
+	int ret = hash_value(name, &value);
+	if(ret <= 0){
+		return ret;
 	}
-	return get_hash_value(Bytes(value.data(), value.size()), key, val);
+	return get_hash_value(value, key, val);
 }
 int SSDBImpl::hgetall(const Bytes &name, std::vector<StrPair>& vals){
-	std::string dbkey = encode_hash_name(name);
-	TERARKDB_NAMESPACE::LazyBuffer value;
-	TERARKDB_NAMESPACE::Status s = ldb->Get(read_opts, dbkey, &value);
-	if(s.IsNotFound()){
-		return 0;
-	}else if(!s.ok()){
-		log_error("%s", s.ToString().c_str());
+	std::string value;
+	int ret = hash_value(name, &value);
+	if(ret <= 0){
+		return ret;
+	}
+	return get_hash_values(value, vals);
+}
+
+// The value is read into an owned string, the one copy out of the engine,
+// and moved into the reply: the cache keeps a copy, a mirrored name is
+// rewritten in place, and the reply is framed on the serve thread after
+// the engine buffer would have been released.
+int SSDBImpl::hgetall_packed(const Bytes &name, std::string *packed){
+	std::string value;
+	int ret = hash_value(name, &value);
+	if(ret <= 0){
+		return ret;
+	}
+	if(value.size() % (2 * sizeof(int16_t)) != 0){
+		return -1;
+	}
+	packed->swap(value);
+	return 1;
+}
+
+int SSDBImpl::multi_hget_packed(const Bytes &name, const std::vector<Bytes> &keys, int offset, std::string *packed){
+	std::string value;
+	int ret = hash_value(name, &value);
+	if(ret <= 0){
+		return ret;
+	}
+	return get_hash_packed(value, keys, offset, packed);
+}
+
+int SSDBImpl::multi_hget_values(const std::vector<Bytes> &names, int offset, std::vector<std::string> *values){
+	int n = names.size() - offset;
+	std::vector<std::string> dbkeys(n);
+	std::vector<bool> mirrored(n);
+	std::vector<uint64_t> gens(n);
+	std::vector<int> misses;
+	std::vector<TERARKDB_NAMESPACE::Slice> slices;
+	values->clear();
+	values->resize(n);
+	for(int i = 0; i < n; i++){
+		mirrored[i] = hash_key(names[offset + i], &dbkeys[i]);
+		if(!cache || !cache->get(dbkeys[i], &(*values)[i], &gens[i])){
+			misses.push_back(i);
+			slices.push_back(dbkeys[i]);
+		}
+	}
+	if(!slices.empty()){
+		std::vector<std::string> found;
+		std::vector<TERARKDB_NAMESPACE::Status> ss = ldb->MultiGet(read_opts, slices, &found);
+		for(int j = 0; j < misses.size(); j++){
+			int i = misses[j];
+			if(ss[j].IsNotFound()){
+				continue;
+			}else if(!ss[j].ok()){
+				log_error("%s", ss[j].ToString().c_str());
+				return -1;
+			}
+			if(cache){
+				cache->put(dbkeys[i], found[j], gens[i]);
+			}
+			(*values)[i].swap(found[j]);
+		}
+	}
+	for(int i = 0; i < n; i++){
+		if(mirrored[i]){
+			mirror_hash_entries(&(*values)[i]);
+		}
+	}
+	return 0;
+}
+
+int SSDBImpl::multi_hgetall(const std::vector<Bytes> &names, int offset, std::vector<std::string> *list){
+	std::vector<std::string> values;
+	if(multi_hget_values(names, offset, &values) == -1){
 		return -1;
 	}
-	return get_hash_values(Bytes(value.data(), value.size()), vals);
+	for(int i = 0; i < values.size(); i++){
+		std::vector<StrPair> pairs;
+		if(get_hash_values(values[i], pairs) == -1){
+			continue;
+		}
+		list->push_back(names[offset + i].String());
+		list->push_back(str((int64_t)pairs.size()));
+		for(auto &item : pairs){
+			list->push_back(std::move(item.first));
+			list->push_back(std::move(item.second));
+		}
+	}
+	return 0;
+}
+
+int SSDBImpl::multi_hgetall_packed(const std::vector<Bytes> &names, int offset, std::vector<std::string> *list){
+	std::vector<std::string> values;
+	if(multi_hget_values(names, offset, &values) == -1){
+		return -1;
+	}
+	for(int i = 0; i < values.size(); i++){
+		if(get_hash_value_count(values[i]) == -1){
+			continue;
+		}
+		list->push_back(names[offset + i].String());
+		list->push_back(std::move(values[i]));
+	}
+	return 0;
+}
+
+int SSDBImpl::multi_hsize(const std::vector<Bytes> &names, int offset, std::vector<int64_t> *sizes){
+	std::vector<std::string> values;
+	if(multi_hget_values(names, offset, &values) == -1){
+		return -1;
+	}
+	sizes->resize(values.size());
+	for(int i = 0; i < values.size(); i++){
+		int count = get_hash_value_count(values[i]);
+		(*sizes)[i] = (count == -1)? 0 : count;
+	}
+	return 0;
+}
+
+int SSDBImpl::hbest(const Bytes &name, int limit, int margin, std::vector<StrPair>& vals){
+	std::string value;
+	int ret = hash_value(name, &value);
+	if(ret <= 0){
+		return ret;
+	}
+	return get_hash_best(value, limit, margin, vals);
 }
 
 
 HIterator* SSDBImpl::hscan(const Bytes &name, const Bytes &start, const Bytes &end, uint64_t limit){
-	std::string dbkey = encode_hash_name(name);
-	TERARKDB_NAMESPACE::LazyBuffer value;
-	TERARKDB_NAMESPACE::Status s = ldb->Get(read_opts, dbkey, &value);
-	if(!s.ok()){
+	std::string value;
+	if(hash_value(name, &value) <= 0){
 		return NULL;
 	}
-	return new HIterator(Bytes(value.data(), value.size()), start.String(), end.String(), limit, Iterator::FORWARD);
+	return new HIterator(value, start.String(), end.String(), limit, Iterator::FORWARD);
 }
 
 HIterator* SSDBImpl::hrscan(const Bytes &name, const Bytes &start, const Bytes &end, uint64_t limit){
-	std::string dbkey = encode_hash_name(name);
-	TERARKDB_NAMESPACE::LazyBuffer value;
-	TERARKDB_NAMESPACE::Status s = ldb->Get(read_opts, dbkey, &value);
-	if(!s.ok()){
+	std::string value;
+	if(hash_value(name, &value) <= 0){
 		return NULL;
 	}
-	return new HIterator(Bytes(value.data(), value.size()), start.String(), end.String(), limit, Iterator::BACKWARD);
+	return new HIterator(value, start.String(), end.String(), limit, Iterator::BACKWARD);
 }
 
-static void get_hlist(Iterator *it, std::vector<std::string> *list){
-	while(it->next()){
+static void get_hlist(Iterator *it, uint64_t limit, std::vector<std::string> *list){
+	uint64_t count = 0;
+	while(count < limit && it->next()){
 		Bytes ks = it->key();
 		Bytes vs = it->val();
 		if(ks.data()[0] != DataType::HASH){
 			break;
 		}
+		// all moves deleted by blind hdel, the name is gone
+		if(vs.empty()){
+			continue;
+		}
 		std::string n;
 		if(decode_hash_name(ks, &n) == -1){
 			continue;
@@ -329,6 +633,7 @@ static void get_hlist(Iterator *it, std::vector<std::string> *list){
 		if(get_hash_values(vs, values) == -1){
 			continue;
 		}
+		count ++;
 		list->push_back(n);
 		list->push_back(str(values.size()));
 		std::vector<StrPair>::iterator iter = values.begin();
@@ -351,8 +656,8 @@ int SSDBImpl::hlist(const Bytes &name_s, const Bytes &name_e, uint64_t limit,
 		end = encode_hash_name(name_e);
 	}
 	
-	Iterator *it = this->iterator(start, end, limit);
-	get_hlist(it, list);
+	Iterator *it = this->iterator(start, end, -1);
+	get_hlist(it, limit, list);
 	delete it;
 	return 0;
 }
@@ -370,8 +675,8 @@ int SSDBImpl::hrlist(const Bytes &name_s, const Bytes &name_e, uint64_t limit,
 		end = encode_hash_name(name_e);
 	}
 	
-	Iterator *it = this->rev_iterator(start, end, limit);
-	get_hlist(it, list);
+	Iterator *it = this->rev_iterator(start, end, -1);
+	get_hlist(it, limit, list);
 	delete it;
 	return 0;
 }
@@ -390,12 +695,17 @@ static int hset_one(SSDBImpl *ssdb, const Bytes &name, const Bytes &key, const B
 		log_error("key too long! %s", hexmem(key.data(), key.size()).c_str());
 		return -1;
 	}
-	std::string hkey = encode_hash_name(name);
-	std::string new_value = encode_hash_value(key, val);
+	std::string hkey;
+	std::string new_value;
+	if(ssdb->hash_key(name, &hkey)){
+		new_value = encode_hash_value(mirror_hash_field(key), val);
+	}else{
+		new_value = encode_hash_value(key, val);
+	}
 	if (!new_value.empty()) {
 		Transaction trans(ssdb->binlogs);
 		ssdb->binlogs->Merge(hkey, slice(new_value));
-		ssdb->binlogs->add_log(log_type, BinlogCommand::HSET, hkey);
+		ssdb->log_hash_merge(hkey, new_value, log_type);
 		TERARKDB_NAMESPACE::Status s = ssdb->binlogs->commit();
 		if(!s.ok()){
 			return -1;
@@ -6,9 +6,16 @@ found in the LICENSE file.
 #ifndef SSDB_HASH_H_
 #define SSDB_HASH_H_
 
+#include <algorithm>
+#include <limits.h>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
 #include "ssdb_impl.h"
 
 static const std::string kDelTag = "32767";
+// leading byte of an increment merge operand
+static const char kHashIncrTag = 'I';
 
 const char SQ_File[90] = {
 	'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i',
@@ -93,13 +100,35 @@ std::string encode_hash_value(const Bytes &key, const Bytes& value){
 	}
 	return buf;
 }
+// scores are int16, 0x7FFF is the tombstone
 inline static
-int decode_hash_value(const Bytes &slice, std::string *key, std::string* value){
-	if(slice.size() < 2 * sizeof(int16_t))
-	{
-		return -1;
+int16_t clamp_hash_score(int64_t score){
+	if(score > 0x7FFE){
+		return 0x7FFE;
+	}
+	if(score < -0x7FFF){
+		return -0x7FFF;
+	}
+	return (int16_t)score;
+}
+
+// merge operand adding by to the score of key
+inline static
+std::string encode_hash_incr(const Bytes &key, int64_t by){
+	std::string buf;
+	int16_t encoded_key;
+	if(encode_hash_key(key, &encoded_key)){
+		buf.reserve(1 + 2 * sizeof(int16_t));
+		buf.push_back(kHashIncrTag);
+		buf.append((char*)&encoded_key, sizeof(int16_t));
+		int16_t val = clamp_hash_score(by);
+		buf.append((char*)&val, sizeof(int16_t));
 	}
-	int16_t encoded = *(int16_t*)slice.data();
+	return buf;
+}
+
+inline static
+int decode_hash_key(int16_t encoded, std::string *key){
 	int src = encoded >> 8;
 	int dst = encoded & 0x7F;
 	if(encoded & 0x80)
@@ -141,13 +170,109 @@ int decode_hash_value(const Bytes &slice, std::string *key, std::string* value){
 		(*key)[2] = SQ_File[dst];
 		(*key)[3] = SQ_Rank[dst];
 	}
+	return 0;
+}
+
+inline static
+int decode_hash_value(const Bytes &slice, std::string *key, std::string* value){
+	if(slice.size() < 2 * sizeof(int16_t))
+	{
+		return -1;
+	}
+	if(decode_hash_key(*(int16_t*)slice.data(), key) == -1){
+		return -1;
+	}
 	int16_t val = *(int16_t*)(slice.data() + sizeof(int16_t));
 	*value = str(val);
 	return 0;
 }
 
+// a packed hash value is an array of (int16 move, int16 score) entries,
+// sorted by move when written with hash.sorted enabled, or in merge order
+// by older servers. Readers must accept both layouts.
+struct HashEntry {
+	int16_t move;
+	int16_t score;
+};
+
+inline static
+bool hash_entry_less(const HashEntry &a, const HashEntry &b){
+	return a.move < b.move;
+}
+
+inline static
+bool hash_value_sorted(const char *data, int count){
+	const HashEntry *entries = (const HashEntry *)data;
+	bool sorted = true;
+	for(int i = 1; i < count; i++){
+		sorted &= entries[i - 1].move < entries[i].move;
+	}
+	return sorted;
+}
+
+// sorts entries by move and drops the later entries of a move, keeping
+// the one a lookup of the unsorted layout finds, returns the new count
+inline static
+int sort_hash_entries(char *data, int count){
+	HashEntry *entries = (HashEntry *)data;
+	std::stable_sort(entries, entries + count, hash_entry_less);
+	HashEntry *end = std::unique(entries, entries + count,
+		[](const HashEntry &a, const HashEntry &b){ return a.move == b.move; });
+	return end - entries;
+}
+
+// returns the index of the entry for move, -1 if not found
 inline static
-int get_hash_value(const Bytes& slice, const Bytes& field, std::string* value) {
+int find_hash_entry(const char *data, int count, int16_t move, bool sorted){
+	const HashEntry *entries = (const HashEntry *)data;
+	if(sorted){
+		// branchless lower bound
+		const HashEntry *base = entries;
+		int n = count;
+		while(n > 1){
+			int half = n / 2;
+			base = (base[half].move <= move)? base + half : base;
+			n -= half;
+		}
+		if(count > 0 && base->move == move){
+			return base - entries;
+		}
+		return -1;
+	}
+	int i = 0;
+#if defined(__AVX2__)
+	const __m256i mask = _mm256_set1_epi32(0xFFFF);
+	const __m256i target = _mm256_set1_epi32((uint16_t)move);
+	for(; i + 8 <= count; i += 8){
+		__m256i v = _mm256_loadu_si256((const __m256i *)(entries + i));
+		__m256i eq = _mm256_cmpeq_epi32(_mm256_and_si256(v, mask), target);
+		int bits = _mm256_movemask_ps(_mm256_castsi256_ps(eq));
+		if(bits){
+			return i + __builtin_ctz(bits);
+		}
+	}
+#elif defined(__SSE2__)
+	const __m128i mask = _mm_set1_epi32(0xFFFF);
+	const __m128i target = _mm_set1_epi32((uint16_t)move);
+	for(; i + 4 <= count; i += 4){
+		__m128i v = _mm_loadu_si128((const __m128i *)(entries + i));
+		__m128i eq = _mm_cmpeq_epi32(_mm_and_si128(v, mask), target);
+		int bits = _mm_movemask_ps(_mm_castsi128_ps(eq));
+		if(bits){
+			return i + __builtin_ctz(bits);
+		}
+	}
+#endif
+	for(; i < count; i++){
+		if(entries[i].move == move){
+			return i;
+		}
+	}
+	return -1;
+}
+
+inline static
+int get_hash_value(const Bytes& slice, const Bytes& field, std::string* value, bool sorted=false) {
 	if (slice.empty() || slice.size() % (2 * sizeof(int16_t)) != 0) {
 		return -1;
 	}
@@ -155,27 +280,107 @@ int get_hash_value(const Bytes& slice, const Bytes& field, std::string* value) {
 	if(!encode_hash_key(field, &target_key)){
 		return 0;
 	}
+	int count = slice.size() / (2 * sizeof(int16_t));
+	int i = find_hash_entry(slice.data(), count, target_key, sorted);
+	if(i == -1){
+		return 0;
+	}
+	if(value){
+		*value = str(((const HashEntry *)slice.data())[i].score);
+	}
+	return 1;
+}
+
+inline static
+int get_hash_values(const Bytes& slice, std::vector<StrPair>& values) {
+	if (slice.empty() || slice.size() % (2 * sizeof(int16_t)) != 0) {
+		return -1;
+	}
+	values.reserve(slice.size() / (2 * sizeof(int16_t)));
 	for (int i = 0; i < slice.size(); i += 2 * sizeof(int16_t)) {
-		if(*(const int16_t*)(slice.data() + i) == target_key){
-			if(value){
-				int16_t val = *(const int16_t*)(slice.data() + i + sizeof(int16_t));
-				*value = str(val);
-			}
-			return 1;
+		std::string elem_field, elem_value;
+		if(decode_hash_value(Bytes(slice.data() + i, 2 * sizeof(int16_t)), &elem_field, &elem_value) == 0) {
+			values.emplace_back(std::move(elem_field), std::move(elem_value));
 		}
 	}
 	return 0;
 }
 
+// fields paired with their packed entries, scores are left unformatted
 inline static
-int get_hash_values(const Bytes& slice, std::vector<StrPair>& values) {
+int get_hash_fields(const Bytes& slice, std::vector<StrPair>& values) {
 	if (slice.empty() || slice.size() % (2 * sizeof(int16_t)) != 0) {
 		return -1;
 	}
 	values.reserve(slice.size() / (2 * sizeof(int16_t)));
 	for (int i = 0; i < slice.size(); i += 2 * sizeof(int16_t)) {
+		std::string elem_field;
+		if(decode_hash_key(*(const int16_t*)(slice.data() + i), &elem_field) == 0) {
+			values.emplace_back(std::move(elem_field), std::string(slice.data() + i, 2 * sizeof(int16_t)));
+		}
+	}
+	return 0;
+}
+
+// appends the packed entries of fields found in slice, in the order given
+inline static
+int get_hash_packed(const Bytes& slice, const std::vector<Bytes> &fields, int offset, std::string *packed) {
+	if (slice.empty() || slice.size() % (2 * sizeof(int16_t)) != 0) {
+		return -1;
+	}
+	int count = slice.size() / (2 * sizeof(int16_t));
+	int n = fields.size() - offset;
+	bool sorted = n > 1 && hash_value_sorted(slice.data(), count);
+	for (int i = offset; i < fields.size(); i++) {
+		int16_t target_key;
+		if (!encode_hash_key(fields[i], &target_key)) {
+			continue;
+		}
+		int idx = find_hash_entry(slice.data(), count, target_key, sorted);
+		if (idx != -1) {
+			packed->append(slice.data() + idx * sizeof(HashEntry), sizeof(HashEntry));
+		}
+	}
+	return 0;
+}
+
+inline static
+int get_hash_best(const Bytes& slice, int limit, int margin, std::vector<StrPair>& values) {
+	if (slice.empty() || slice.size() % (2 * sizeof(int16_t)) != 0) {
+		return -1;
+	}
+	const HashEntry *entries = (const HashEntry *)slice.data();
+	int count = slice.size() / (2 * sizeof(int16_t));
+	int best = INT_MIN;
+	for (int i = 0; i < count; i++) {
+		if (entries[i].score != 0x7FFF && entries[i].score > best) {
+			best = entries[i].score;
+		}
+	}
+	if (best == INT_MIN) {
+		return 0;
+	}
+	int min_score = (margin >= 0)? best - margin : INT_MIN;
+	std::vector<HashEntry> top;
+	top.reserve(count);
+	for (int i = 0; i < count; i++) {
+		if (entries[i].score != 0x7FFF && entries[i].score >= min_score) {
+			top.push_back(entries[i]);
+		}
+	}
+	auto better = [](const HashEntry &a, const HashEntry &b) {
+		return a.score > b.score || (a.score == b.score && a.move < b.move);
+	};
+	if (limit > 0 && limit < (int)top.size()) {
+		std::partial_sort(top.begin(), top.begin() + limit, top.end(), better);
+		top.resize(limit);
+	} else {
+		std::sort(top.begin(), top.end(), better);
+	}
+	values.reserve(top.size());
+	for (auto &e : top) {
 		std::string elem_field, elem_value;
-		if(decode_hash_value(Bytes(slice.data() + i, 2 * sizeof(int16_t)), &elem_field, &elem_value) == 0) {
+		if(decode_hash_value(Bytes((const char *)&e, sizeof(e)), &elem_field, &elem_value) == 0) {
 			values.emplace_back(std::move(elem_field), std::move(elem_value));
 		}
 	}
@@ -202,4 +407,32 @@ int get_hash_bytes(const Bytes& slice, std::vector<BytesPair>& values) {
 	}
 	return 0;
 }
+// left-right mirror of an encoded move, files a..i become i..a
+inline static
+int16_t mirror_hash_key(int16_t encoded){
+	int src = (encoded >> 8) & 0x7F;
+	int dst = encoded & 0x7F;
+	src += 8 - 2 * (src % 9);
+	dst += 8 - 2 * (dst % 9);
+	return (src << 8) + (encoded & 0x80) + dst;
+}
+
+inline static
+std::string mirror_hash_field(const Bytes &field){
+	std::string ret(field.data(), field.size());
+	if(ret.size() >= 4){
+		ret[0] = 'a' + ('i' - ret[0]);
+		ret[2] = 'a' + ('i' - ret[2]);
+	}
+	return ret;
+}
+
+inline static
+void mirror_hash_entries(std::string *value){
+	int count = value->size() / (2 * sizeof(int16_t));
+	HashEntry *entries = (HashEntry *)&(*value)[0];
+	for(int i = 0; i < count; i++){
+		entries[i].move = mirror_hash_key(entries[i].move);
+	}
+}
 #endif
@@ -149,6 +149,20 @@ int SSDBImpl::incr(const Bytes &key, int64_t by, int64_t *new_val, char log_type
 		log_error("name too long! %s", hexmem(key.data(), key.size()).c_str());
 		return -1;
 	}
+	if(merge_counters){
+		std::string buf = encode_kv_key(key);
+		Transaction trans(binlogs);
+		binlogs->Merge(buf, TERARKDB_NAMESPACE::Slice((const char *)&by, sizeof(by)));
+		binlogs->add_log(log_type, BinlogCommand::KSET, buf);
+		TERARKDB_NAMESPACE::Status s = binlogs->commit();
+		if(!s.ok()){
+			log_error("incr error: %s", s.ToString().c_str());
+			return -1;
+		}
+		// a blind write, the value is folded by reads and compaction
+		*new_val = by;
+		return 1;
+	}
 	std::string old;
 	int ret = this->get(key, &old);
 	if(ret == -1){
@@ -0,0 +1,50 @@
+/*
+Copyright (c) 2012-2014 The SSDB Authors. All rights reserved.
+Use of this source code is governed by a BSD-style license that can be
+found in the LICENSE file.
+*/
+#include <string>
+#include "ssdb_impl.h"
+#include "../util/log.h"
+
+// a batch with more updates than logs must not look like a wal gap to
+// the log after it
+int main(int argc, char **argv){
+	set_log_level(Logger::LEVEL_ERROR);
+	std::string work_dir = "./tmp/wal_binlog";
+	Options opt;
+	opt.compression = false;
+	opt.wal = true;
+	opt.binlog = true;
+	opt.binlog_wal = true;
+
+	SSDBImpl *ssdb = (SSDBImpl *)SSDB::open(opt, work_dir);
+	if(!ssdb){
+		fprintf(stderr, "could not open work_dir: %s\n", work_dir.c_str());
+		exit(1);
+	}
+	BinlogQueue *logs = ssdb->binlogs;
+	uint64_t start = logs->max_seq() + 1;
+	// Delete + Put + Put and one log
+	ssdb->zset("z", "a", "1");
+	ssdb->zset("z", "a", "2");
+	ssdb->set("k", "v");
+
+	WalLogReader reader(logs);
+	const char cmds[] = {BinlogCommand::ZSET, BinlogCommand::ZSET, BinlogCommand::KSET};
+	uint64_t seq = start;
+	int failed = 0;
+	for(int i = 0; i < 3; i++){
+		Binlog log;
+		int ret = reader.find_next(seq, &log);
+		if(ret != 1 || log.cmd() != cmds[i]){
+			fprintf(stderr, "log %d: ret %d, seq %" PRIu64 "\n", i, ret, seq);
+			failed ++;
+			break;
+		}
+		seq = log.seq() + 1;
+	}
+	printf("%s\n", failed? "FAILED" : "OK");
+	delete ssdb;
+	return failed? 1 : 0;
+}
@@ -9,7 +9,10 @@ found in the LICENSE file.
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <dirent.h>
+#include <stdio.h>
 #include <string>
+#include <vector>
 
 static inline
 bool file_exists(const std::string &filename){
@@ -67,4 +70,35 @@ int file_put_contents(const std::string &filename, const std::string &content){
 	return ret == (int)content.size()? ret : -1;
 }
 
+// names of the regular files in dir
+static inline
+int scan_dir(const std::string &dir, std::vector<std::string> *names){
+	DIR *dp = opendir(dir.c_str());
+	if(!dp){
+		return -1;
+	}
+	struct dirent *ent;
+	while((ent = readdir(dp)) != NULL){
+		std::string name = ent->d_name;
+		if(is_file(dir + "/" + name)){
+			names->push_back(name);
+		}
+	}
+	closedir(dp);
+	return 0;
+}
+
+// removes dir and the regular files in it
+static inline
+int remove_dir(const std::string &dir){
+	std::vector<std::string> names;
+	if(scan_dir(dir, &names) == -1){
+		return -1;
+	}
+	for(int i = 0; i < (int)names.size(); i++){
+		unlink((dir + "/" + names[i]).c_str());
+	}
+	return rmdir(dir.c_str());
+}
+
 #endif
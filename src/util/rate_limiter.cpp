@@ -0,0 +1,58 @@
+/*
+Copyright (c) 2012-2014 The SSDB Authors. All rights reserved.
+Use of this source code is governed by a BSD-style license that can be
+found in the LICENSE file.
+*/
+#include <sys/time.h>
+#include "rate_limiter.h"
+
+static int64_t time_us(){
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	return (int64_t)now.tv_sec * 1000 * 1000 + now.tv_usec;
+}
+
+RateLimiter::RateLimiter(double rate){
+	rate_ = rate > 0? rate : 0;
+	tokens = 0;
+	last_us = time_us();
+}
+
+void RateLimiter::set_rate(double rate){
+	rate = rate > 0? rate : 0;
+	Locking l(&mutex);
+	if(rate == rate_){
+		return;
+	}
+	rate_ = rate;
+	// debt taken at the old rate is not carried over
+	if(tokens < 0){
+		tokens = 0;
+	}
+}
+
+double RateLimiter::rate(){
+	Locking l(&mutex);
+	return rate_;
+}
+
+int64_t RateLimiter::take(int64_t bytes){
+	Locking l(&mutex);
+	int64_t now = time_us();
+	if(rate_ <= 0){
+		tokens = 0;
+		last_us = now;
+		return 0;
+	}
+	tokens += (now - last_us) * rate_ / (1000 * 1000);
+	last_us = now;
+	double burst = rate_ * BURST_MS / 1000;
+	if(tokens > burst){
+		tokens = burst;
+	}
+	tokens -= bytes;
+	if(tokens >= 0){
+		return 0;
+	}
+	return (int64_t)(-tokens * 1000 * 1000 / rate_);
+}
@@ -0,0 +1,35 @@
+/*
+Copyright (c) 2012-2014 The SSDB Authors. All rights reserved.
+Use of this source code is governed by a BSD-style license that can be
+found in the LICENSE file.
+*/
+#ifndef UTIL_RATE_LIMITER_H_
+#define UTIL_RATE_LIMITER_H_
+
+#include <stdint.h>
+#include <string>
+#include "thread.h"
+
+// Token bucket in bytes per second. Bytes are taken after they have been
+// sent, the bucket goes into debt and the caller waits it off, so one
+// send may overshoot but the average rate holds.
+class RateLimiter{
+public:
+	// rate <= 0: unlimited
+	RateLimiter(double rate=0);
+	void set_rate(double rate);
+	double rate();
+	// returns how long to wait before sending again, in microseconds
+	int64_t take(int64_t bytes);
+
+private:
+	// tokens saved up while idle, in ms of rate
+	static const int BURST_MS = 100;
+
+	Mutex mutex;
+	double rate_;
+	double tokens;
+	int64_t last_us;
+};
+
+#endif
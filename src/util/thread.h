@@ -12,7 +12,9 @@ found in the LICENSE file.
 #include <string.h>
 #include <errno.h>
 #include <pthread.h>
+#include <sched.h>
 #include <queue>
+#include <deque>
 #include <vector>
 #include <sys/eventfd.h>
 #include <atomic>
@@ -34,6 +36,45 @@ static inline int futex_wake(int* addr, int n) {
 	return syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
 }
 
+// the cores this process may run on, taken at the first call, which
+// must come before any thread is pinned
+inline const cpu_set_t* process_cpus() {
+	static cpu_set_t set;
+	static bool ok = (sched_getaffinity(0, sizeof(set), &set) == 0 && CPU_COUNT(&set) > 0);
+	return ok ? &set : NULL;
+}
+
+static inline int cpu_count() {
+	const cpu_set_t* set = process_cpus();
+	if (set != NULL)
+		return CPU_COUNT(set);
+	int n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? n : 1;
+}
+
+// pins the calling thread to the nth core of cpus, wrapping around
+static inline int pin_thread(const cpu_set_t* cpus, int n) {
+	if (cpus == NULL || CPU_COUNT(cpus) == 0)
+		return -1;
+	n %= CPU_COUNT(cpus);
+	for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (CPU_ISSET(cpu, cpus) && n-- == 0) {
+			cpu_set_t one;
+			CPU_ZERO(&one);
+			CPU_SET(cpu, &one);
+			return pthread_setaffinity_np(pthread_self(), sizeof(one), &one) == 0 ? cpu : -1;
+		}
+	}
+	return -1;
+}
+
+// lets a thread started by a pinned one run on any core of the process
+static inline void unpin_thread() {
+	const cpu_set_t* set = process_cpus();
+	if (set != NULL)
+		pthread_setaffinity_np(pthread_self(), sizeof(*set), set);
+}
+
 class Mutex {
 private:
 	pthread_mutex_t mutex;
@@ -69,21 +110,36 @@ public:
 
 };
 
-// Thread safe queue
-template <class T, size_t CAP> class Queue {
-	static_assert((CAP& (CAP - 1)) == 0, "CAP must be power of two");
-	static_assert(CAP <= (1ull << 63), "CAP must be < 2^63 for wrap-safe signed diffs");
+// Thread safe queue, lock-free up to cap items (rounded up to a power of
+// two). Beyond that items spill into a locked list, which only allocates
+// while the queue is backed up and is drained after the ring.
+template <class T> class Queue {
 private:
 	struct alignas(64) Slot {
 		std::atomic<uint64_t> seq;
-		alignas(64) T item;
+		T item;
 	};
-	Slot ring_[CAP];
+	Slot* ring_;
+	size_t cap_;
 
 	alignas(64) std::atomic<uint64_t> tail_{ 0 };
 	alignas(64) std::atomic<uint64_t> head_{ 0 };
+
+	// pushes go to the spill list while it is not empty, to keep order
+	alignas(64) std::atomic<size_t> spilled_{ 0 };
+	Mutex spill_mutex_;
+	std::deque<T> spill_;
+
+	bool push_ring(T& item);
+	bool pop_ring(T* data);
+	// No copying allowed
+	Queue(const Queue&);
+	void operator=(const Queue&);
 public:
-	Queue();
+	static const size_t DEFAULT_CAP = 1024;
+
+	Queue(size_t cap = DEFAULT_CAP);
+	~Queue();
 
 	void push(T item);
 	bool pop(T* data);
@@ -107,11 +163,14 @@ public:
 	};
 private:
 	std::string name;
-	Queue<JOB, (1 << 16)> jobs;
+	Queue<JOB> jobs;
 
 	int num_workers;
 	std::vector<pthread_t> tids;
 	bool started;
+	// worker i is pinned by pin_thread(cpus, first_cpu + i), NULL: not pinned
+	const cpu_set_t* cpus;
+	int first_cpu;
 
 	struct run_arg {
 		int id;
@@ -119,49 +178,105 @@ private:
 	};
 	pthread_mutex_t mutex;
 	alignas(64) int pending_work;
+	// jobs pushed and not yet taken by a worker
+	alignas(64) std::atomic<int> queued;
+	std::atomic<int> peak_queued;
+	std::atomic<uint64_t> total_jobs;
 	static void* _run_worker(void* arg);
 public:
 	WorkerPool(const char* name = "");
 	~WorkerPool();
 
-	void start(int num_workers);
+	void start(int num_workers, const cpu_set_t* cpus = NULL, int first_cpu = 0);
 	void stop();
 
 	void push(JOB& job);
+
+	const std::string& get_name() const { return name; }
+	int size() const { return started ? num_workers : 0; }
+	int queue_size() const { return queued.load(std::memory_order_relaxed); }
+	// the deepest the queue has been since the last call
+	int reset_peak() { return peak_queued.exchange(queue_size(), std::memory_order_relaxed); }
+	uint64_t job_count() const { return total_jobs.load(std::memory_order_relaxed); }
 };
 
-template <class T, size_t CAP>
-Queue<T, CAP>::Queue() {
-	for (size_t i = 0; i < CAP; i++)
+template <class T>
+Queue<T>::Queue(size_t cap) {
+	cap_ = 2;
+	while (cap_ < cap)
+		cap_ <<= 1;
+	ring_ = new Slot[cap_];
+	for (size_t i = 0; i < cap_; i++)
 		ring_[i].seq.store(i, std::memory_order_relaxed);
 }
 
-template <class T, size_t CAP>
-void Queue<T, CAP>::push(T item) {
-	uint64_t pos = tail_.fetch_add(1, std::memory_order_relaxed);
-	Slot& s = ring_[pos & (CAP - 1)];
+template <class T>
+Queue<T>::~Queue() {
+	delete[] ring_;
+}
+
+template <class T>
+void Queue<T>::push(T item) {
+	if (spilled_.load(std::memory_order_acquire) == 0 && push_ring(item))
+		return;
+	Locking l(&spill_mutex_);
+	spill_.push_back(std::move(item));
+	spilled_.fetch_add(1, std::memory_order_release);
+}
+
+template <class T>
+bool Queue<T>::pop(T* data) {
+	if (pop_ring(data))
+		return true;
+	if (spilled_.load(std::memory_order_acquire) == 0)
+		return false;
+	Locking l(&spill_mutex_);
+	if (spill_.empty())
+		return false;
+	*data = std::move(spill_.front());
+	spill_.pop_front();
+	spilled_.fetch_sub(1, std::memory_order_release);
+	return true;
+}
+
+template <class T>
+bool Queue<T>::push_ring(T& item) {
+	uint64_t pos = tail_.load(std::memory_order_relaxed);
 	for (;;) {
+		Slot& s = ring_[pos & (cap_ - 1)];
 		uint64_t seq = s.seq.load(std::memory_order_acquire);
 		int64_t dif = (int64_t)(seq - pos);
-		if (dif == 0) break;
-		CPU_RELAX();
+		if (dif == 0) {
+			if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed,
+				std::memory_order_relaxed)) {
+				s.item = std::move(item);
+				s.seq.store(pos + 1, std::memory_order_release);
+				return true;
+			}
+			CPU_RELAX();
+		}
+		else if (dif < 0) {
+			return false; // full
+		}
+		else {
+			CPU_RELAX();
+			pos = tail_.load(std::memory_order_relaxed);
+		}
 	}
-	s.item = std::move(item);
-	s.seq.store(pos + 1, std::memory_order_release);
 }
 
-template <class T, size_t CAP>
-bool Queue<T, CAP>::pop(T* data) {
+template <class T>
+bool Queue<T>::pop_ring(T* data) {
 	uint64_t pos = head_.load(std::memory_order_relaxed);
 	for (;;) {
-		Slot& s = ring_[pos & (CAP - 1)];
+		Slot& s = ring_[pos & (cap_ - 1)];
 		uint64_t seq = s.seq.load(std::memory_order_acquire);
 		int64_t dif = (int64_t)(seq - (pos + 1));
 		if (dif == 0) {
 			if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_acq_rel,
 				std::memory_order_relaxed)) {
 				*data = std::move(s.item);
-				s.seq.store(pos + CAP, std::memory_order_release);
+				s.seq.store(pos + cap_, std::memory_order_release);
 				return true;
 			}
 			else {
@@ -185,6 +300,12 @@ WorkerPool<W, JOB>::WorkerPool(const char* name) {
 	this->name = name;
 	this->started = false;
 	this->pending_work = 0;
+	this->cpus = NULL;
+	this->first_cpu = 0;
+	this->num_workers = 0;
+	this->queued = 0;
+	this->peak_queued = 0;
+	this->total_jobs = 0;
 }
 
 template<class W, class JOB>
@@ -195,6 +316,11 @@ WorkerPool<W, JOB>::~WorkerPool() {
 
 template<class W, class JOB>
 void WorkerPool<W, JOB>::push(JOB& job) {
+	int n = queued.fetch_add(1, std::memory_order_relaxed) + 1;
+	int peak = peak_queued.load(std::memory_order_relaxed);
+	while (n > peak && !peak_queued.compare_exchange_weak(peak, n, std::memory_order_relaxed)) {
+	}
+	total_jobs.fetch_add(1, std::memory_order_relaxed);
 	jobs.push(std::move(job));
 	pthread_mutex_lock(&mutex);
 	bool need_wake = (pending_work == 0);
@@ -211,6 +337,8 @@ void* WorkerPool<W, JOB>::_run_worker(void* arg) {
 	WorkerPool* tp = p->tp;
 	delete p;
 
+	if (tp->cpus != NULL)
+		pin_thread(tp->cpus, tp->first_cpu + id);
 	W w(tp->name);
 	Worker* worker = (Worker*)&w;
 	worker->id = id;
@@ -230,6 +358,7 @@ void* WorkerPool<W, JOB>::_run_worker(void* arg) {
 		pthread_mutex_unlock(&tp->mutex);
 		JOB job;
 		while (tp->jobs.pop(&job)) {
+			tp->queued.fetch_sub(1, std::memory_order_relaxed);
 			worker->proc(&job);
 		}
 	}
@@ -239,7 +368,7 @@ void* WorkerPool<W, JOB>::_run_worker(void* arg) {
 }
 
 template<class W, class JOB>
-void WorkerPool<W, JOB>::start(int num_workers) {
+void WorkerPool<W, JOB>::start(int num_workers, const cpu_set_t* cpus, int first_cpu) {
 	pthread_mutex_lock(&mutex);
 	if (started) {
 		pthread_mutex_unlock(&mutex);
@@ -248,6 +377,8 @@ void WorkerPool<W, JOB>::start(int num_workers) {
 	started = true;
 	pthread_mutex_unlock(&mutex);
 	this->num_workers = num_workers;
+	this->cpus = cpus;
+	this->first_cpu = first_cpu;
 	int err;
 	pthread_t tid;
 	for (int i = 0; i < num_workers; i++) {
@@ -11,6 +11,7 @@ found in the LICENSE file.
 #include <string>
 #include <vector>
 #include <map>
+#include <algorithm>
 #include "net/link.h"
 #include "net/fde.h"
 #include "util/log.h"
@@ -25,11 +26,14 @@ struct Data
 	std::string hkey;
 	std::string hnum;
 	std::string num;
+	// multi_hset request
+	std::vector<std::string> hkvs;
 };
 
 std::map<std::string, Data *> *ds;
 Fdevents *fdes;
 std::vector<Link *> *free_links;
+std::map<Link *, double> *send_times;
 
 
 void welcome(){
@@ -72,6 +76,17 @@ void init_data(int num){
 		d->hnum = buf;
 		snprintf(buf, sizeof(buf), "%d", n);
 		d->num = buf;
+		d->hkvs.push_back("multi_hset");
+		d->hkvs.push_back(d->key);
+		for(int i=0; i<8; i++){
+			int m = n + i * 7919;
+			buf[0] = 'a' + (m % 9);
+			buf[1] = '0' + ((m / 9) % 10);
+			buf[2] = 'a' + ((m / 90) % 9);
+			buf[3] = '0' + ((m / 810) % 10);
+			d->hkvs.push_back(std::string(buf, 4));
+			d->hkvs.push_back(d->hnum);
+		}
 		ds->insert(make_pair(d->key, d));
 	}
 }
@@ -79,6 +94,7 @@ void init_data(int num){
 void init_links(int num, const char *ip, int port){
 	fdes = new Fdevents();
 	free_links = new std::vector<Link *>();
+	send_times = new std::map<Link *, double>();
 
 	for(int i=0; i<num; i++){
 		Link *link = Link::connect(ip, port);
@@ -104,6 +120,8 @@ void send_req(Link *link, const std::string &cmd, const Data *d){
 		link->send(cmd, d->key, d->hkey);
 	}else if(cmd == "hdel"){
 		link->send(cmd, d->key, d->hkey);
+	}else if(cmd == "multi_hset"){
+		link->send(d->hkvs);
 	}else if(cmd == "zset"){
 		link->send(cmd, "TEST", d->key, d->num);
 	}else if(cmd == "zget"){
@@ -118,6 +136,7 @@ void send_req(Link *link, const std::string &cmd, const Data *d){
 		log_error("bad command!");
 		exit(0);
 	}
+	(*send_times)[link] = microtime();
 	link->flush();
 }
 
@@ -125,6 +144,8 @@ void bench(std::string cmd){
 	int total = (int)ds->size();
 	int finished = 0;
 	int num_sent = 0;
+	std::vector<double> latencies;
+	latencies.reserve(total);
 	
 	printf("========== %s ==========\n", cmd.c_str());
 
@@ -175,6 +196,7 @@ void bench(std::string cmd){
 					log_error("bad response: %s", status.String().c_str());
 					exit(0);
 				}
+				latencies.push_back(microtime() - (*send_times)[link]);
 				free_links->push_back(link);
 				finished ++;
 				if(finished == total){
@@ -182,6 +204,15 @@ void bench(std::string cmd){
 					double ts = (stime == etime)? 1 : (etime - stime);
 					double speed = total / ts;
 					printf("qps: %d, time: %.3f s\n", (int)speed, ts);
+					std::sort(latencies.begin(), latencies.end());
+					double sum = 0;
+					for(int i=0; i<(int)latencies.size(); i++){
+						sum += latencies[i];
+					}
+					printf("latency avg: %.3f ms, p50: %.3f ms, p99: %.3f ms\n",
+						sum / total * 1000,
+						latencies[total / 2] * 1000,
+						latencies[(int)(total * 0.99)] * 1000);
 					return;
 				}
 			}
@@ -227,6 +258,8 @@ int main(int argc, char **argv){
 	bench("hset");
 	bench("hget");
 	bench("hdel");
+	// concurrent batched writes, stresses binlog group commit
+	bench("multi_hset");
 
 	bench("zset");
 	bench("zget");